@@ -63,8 +63,8 @@ namespace kvDB {
         ::write(connfd_,buf.c_str(),buf.size());
     }
 
-    void DBClient::Recv(char* buf) const {
-        ::read(connfd_,buf,1024);
+    ssize_t DBClient::Recv(char* buf, size_t len) const {
+        return ::read(connfd_,buf,len);
     }
 
     void DBClient::parseCmd() {
@@ -78,6 +78,11 @@ namespace kvDB {
             tmp = tmp.substr(0, pos);
             if(tmp == "quit")
                 break;
+            if(tmp.empty()){
+                // 服务器跳过空行，不会回复
+                std::cout << "kvDB> ";
+                continue;
+            }
             if(tmp == "help"){
                 std::cout<<helpTxt;
                 std::cout << "kvDB> ";
@@ -89,11 +94,21 @@ namespace kvDB {
     }
 
     void DBClient::handleRequest(const std::string &buf) {
-        char buffer[1024] = {0};
+        char buffer[1024];
+        std::string reply;
 
-        Send(buf);
-        Recv(buffer);
-        std::cout << buffer << std::endl;
+        Send(buf + "\r\n");
+        // 服务器的回复以\r\n结尾，可能要读多次
+        while (reply.size() < 2 || reply.compare(reply.size() - 2, 2, "\r\n") != 0) {
+            ssize_t n = Recv(buffer, sizeof(buffer));
+            if (n <= 0) {
+                std::cout << "connection closed" << std::endl;
+                return;
+            }
+            reply.append(buffer, n);
+        }
+        reply.resize(reply.size() - 2);
+        std::cout << reply << std::endl;
     }
 
 }
\ No newline at end of file
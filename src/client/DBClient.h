@@ -13,6 +13,7 @@
 #define KVDB_DBCLIENT_H
 
 #include <string>
+#include <sys/types.h>
 
 namespace kvDB {
     class DBClient {
@@ -27,10 +28,12 @@ namespace kvDB {
 
         void Send(const std::string &buf) const;
 
-        void Recv(char *buf) const ;
+        /* 读取一次，返回读到的字节数 */
+        ssize_t Recv(char *buf, size_t len) const ;
 
         void parseCmd();
 
+        /* 发送一行命令(加上\r\n)，读到以\r\n结尾的完整回复后输出 */
         void handleRequest(const std::string &buf);
 
     private:
@@ -0,0 +1,83 @@
+/**
+  ******************************************************************************
+  * @file           : CommandArgs.h
+  * @author         : zgys
+  * @brief          : 一条命令的参数列表，参数是指向输入缓冲区的std::string_view
+  * @attention      : 不持有参数的数据，数据(连接的Buffer或threaded-io拷贝出的批量数据)在命令执行完之前不能被修改;
+  *                   参数个数不超过kInline时保存在对象内部的数组中，不分配内存
+  * @date           : 23-4-30
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_COMMANDARGS_H
+#define KVDB_COMMANDARGS_H
+
+#include <string_view>
+#include <vector>
+#include <cassert>
+
+namespace kvDB {
+    class CommandArgs {
+    public:
+        static const size_t kInline = 8;
+
+        CommandArgs() : size_(0) {}
+
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        const std::string_view& operator[](size_t i) const {
+            assert(i < size_);
+            return data()[i];
+        }
+
+        const std::string_view* begin() const { return data(); }
+        const std::string_view* end() const { return data() + size_; }
+
+        void push_back(std::string_view arg) {
+            if (heap_.empty() && size_ < kInline) {
+                inline_[size_++] = arg;
+                return;
+            }
+            /* 超过kInline个参数(如rpush多个元素)时整体移到heap_中 */
+            if (heap_.empty()) {
+                heap_.assign(inline_, inline_ + size_);
+            }
+            heap_.push_back(arg);
+            ++size_;
+        }
+
+        void clear() {
+            size_ = 0;
+            heap_.clear();
+        }
+
+        /* 把一行文本按空格和制表符切分成参数，参数指向line的数据 */
+        void split(std::string_view line) {
+            clear();
+            size_t pos = 0;
+            while (pos < line.size()) {
+                while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t')) {
+                    ++pos;
+                }
+                size_t start = pos;
+                while (pos < line.size() && line[pos] != ' ' && line[pos] != '\t') {
+                    ++pos;
+                }
+                if (pos > start) {
+                    push_back(line.substr(start, pos - start));
+                }
+            }
+        }
+
+    private:
+        const std::string_view* data() const { return heap_.empty() ? inline_ : heap_.data(); }
+
+        std::string_view inline_[kInline];
+        std::vector<std::string_view> heap_;
+        size_t size_;
+    };
+}
+
+#endif //KVDB_COMMANDARGS_H
@@ -8,20 +8,37 @@
   ******************************************************************************
   */
 
-#include <sstream>
+#include <charconv>
 #include <unistd.h>
 #include <fstream>
 #include <cfloat>
+#include <cmath>
+#include <algorithm>
+#include <csignal>
+#include <sys/wait.h>
 #include "DBServer.h"
 #include "./comm/Logger.h"
+#include "./comm/Affinity.h"
 #include "./db/DBStatus.h"
 #include "./db/DBObj.h"
 
 namespace kvDB {
+    /* 读取已经过期的key时旧协议的回复，与Database::getKey一致 */
+    static const char* const kKeyExpired = "The key has expired and will be deleted";
+
     DBServer::DBServer(EventLoop* loop, const InetAddress& localAddr)
-            : loop_(loop),
-              server_(loop_, localAddr, "DBServer"),
-              lastSave_(Timestamp::invalid()) {
+            : lastSave_(Timestamp::invalid()),
+              saveInterval_(0.0),
+              statsInterval_(0.0),
+              commandBudget_(256),
+              byteBudget_(1024 * 1024),
+              childPid_(-1),
+              started_(false),
+              threadedIo_(false),
+              lagThresholdUs_(0),
+              rejectedWrites_(0),
+              loop_(loop),
+              server_(loop_, localAddr, "DBServer") {
 
         server_.setConnectionCallback(
                 std::bind(&DBServer::onConnection, this, std::placeholders::_1));
@@ -41,638 +58,956 @@ namespace kvDB {
 
         dbIndex = 0;
         database_[dbIndex]->rdbLoad(dbIndex);
-        // 绑定命令处理函数
-        cmdDict.insert(std::make_pair("set",
-                                      std::bind(&DBServer::setCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("get",
-                                      std::bind(&DBServer::getCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("pexpire",
-                                      std::bind(&DBServer::pExpiredCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("expire",
-                                      std::bind(&DBServer::expiredCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("bgsave",
-                                      std::bind(&DBServer::bgsaveCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("select",
-                                      std::bind(&DBServer::selectCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("rpush",
-                                      std::bind(&DBServer::rpushCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("rpop",
-                                      std::bind(&DBServer::rpopCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("hset",
-                                      std::bind(&DBServer::hsetCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("hget",
-                                      std::bind(&DBServer::hgetCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("hgetall",
-                                      std::bind(&DBServer::hgetAllCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("sadd",
-                                      std::bind(&DBServer::saddCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("smembers",
-                                      std::bind(&DBServer::smembersCommand, this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("zadd",
-                                      std::bind(&DBServer::zaddCommand,this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("zcard",
-                                      std::bind(&DBServer::zcardCommand,this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("zrange",
-                                      std::bind(&DBServer::zrangeCommand,this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("zcount",
-                                      std::bind(&DBServer::zcountCommand,this, std::placeholders::_1)));
-        cmdDict.insert(std::make_pair("zgetall",
-                                      std::bind(&DBServer::zgetAllCommand,this, std::placeholders::_1)));
-
     }
 
-    void DBServer::onConnection(const TcpConnectionPtr& conn) {
-
+    /* 命令表: 命令名  arity  flags  firstKey  lastKey  keyStep  处理函数 */
+    constexpr DBServer::Command DBServer::kCommands[] = {
+            {"hello",    -1, kCmdRespOnly, 0, 0, 0, &DBServer::helloCommand},
+            {"ping",     -1, 0,            0, 0, 0, &DBServer::pingCommand},
+            {"set",       3, kCmdWrite,    1, 1, 1, &DBServer::setCommand},
+            {"get",       2, kCmdReadOnly, 1, 1, 1, &DBServer::getCommand},
+            {"pexpire",   3, kCmdWrite,    1, 1, 1, &DBServer::pExpiredCommand},
+            {"expire",    3, kCmdWrite,    1, 1, 1, &DBServer::expiredCommand},
+            {"bgsave",    1, kCmdWrite,    0, 0, 0, &DBServer::bgsaveCommand},
+            {"select",    2, 0,            0, 0, 0, &DBServer::selectCommand},
+            {"rpush",    -3, kCmdWrite,    1, 1, 1, &DBServer::rpushCommand},
+            {"rpop",      2, kCmdWrite,    1, 1, 1, &DBServer::rpopCommand},
+            {"hset",      4, kCmdWrite,    1, 1, 1, &DBServer::hsetCommand},
+            {"hget",      3, kCmdReadOnly, 1, 1, 1, &DBServer::hgetCommand},
+            {"hgetall",   2, kCmdReadOnly, 1, 1, 1, &DBServer::hgetAllCommand},
+            {"sadd",      3, kCmdWrite,    1, 1, 1, &DBServer::saddCommand},
+            {"smembers",  2, kCmdReadOnly, 1, 1, 1, &DBServer::smembersCommand},
+            {"zadd",      4, kCmdWrite,    1, 1, 1, &DBServer::zaddCommand},
+            {"zcard",     2, kCmdReadOnly, 1, 1, 1, &DBServer::zcardCommand},
+            {"zrange",    4, kCmdReadOnly, 1, 1, 1, &DBServer::zrangeCommand},
+            {"zcount",    4, kCmdReadOnly, 1, 1, 1, &DBServer::zcountCommand},
+            {"zgetall",   2, kCmdReadOnly, 1, 1, 1, &DBServer::zgetAllCommand},
+    };
+
+    constexpr std::array<uint8_t, DBServer::kCommandSlots> DBServer::buildCommandIndex() {
+        std::array<uint8_t, kCommandSlots> index{};
+        for (size_t i = 0; i < std::size(kCommands); ++i) {
+            index[commandHash(kCommands[i].name)] = static_cast<uint8_t>(i + 1);
+        }
+        return index;
     }
 
-    void DBServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp timestamp) {
-        auto msg = buf->retrieveAsString();
-        auto res = parseMsg(msg);
-
-        conn->send(res);
-    }
+    constexpr std::array<uint8_t, DBServer::kCommandSlots> DBServer::kCommandIndex = buildCommandIndex();
 
-    void DBServer::start() {
-        server_.start();
+    void DBServer::onConnection(const TcpConnectionPtr& conn) {
+        if (conn->connected()) {
+            conn->setContext(ClientState());
+        }
     }
 
-    void DBServer::rdbSave() {
-        pid_t pid = fork();
-        if (pid == 0) {
-            LOG_INFO("child process");
-
-            char buf[1024]{0};
-            std::string path = getcwd(buf, 1024);
-            assert(!path.empty());
-            path += "/dump.rdb";
-
-            std::ofstream out;
-            out.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
-            if (!out.is_open()) {
-                LOG_FATAL("RDB持久化失败...");
+    void DBServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+        auto* client = std::any_cast<ClientState>(conn->getMutableContext());
+        assert(client != nullptr);
+        if (client->protocolError) {
+            // 连接正在关闭
+            buf->retrieve(buf->readableBytes());
+            return;
+        }
+        /* 每次回调最多执行commandBudget_条命令、处理byteBudget_字节，剩下的留在buf中，
+         * 在本轮其他连接处理完之后继续，一个连接的长流水线不会阻塞其他连接 */
+        size_t commands = 0;
+        size_t bytes = 0;
+        Batch batch;                  // threaded-io模式下交给baseLoop执行的命令
+        OutputChain out;              // 本次回调的回复，最后一起发送
+        CommandArgs argv;             // 当前命令的参数，指向buf
+        const bool overloaded = !threadedIo_ && loopOverloaded(conn->getLoop());
+        /* 协议错误回复在前面的命令的回复之后，threaded-io模式下放进batch，由baseLoop按顺序交回 */
+        auto protocolError = [&](bool resp, const std::string& error) {
+            LOG_ERROR("Protocol error from connection %s: %s\n", conn->name().c_str(), error.c_str());
+            client->protocolError = true;
+            buf->retrieve(buf->readableBytes());
+            if (threadedIo_) {
+                batch.protocolError = error;
+                batch.protocolErrorResp = resp;
+            } else if (resp) {
+                Reply::error(DBStatus::IOError("Protocol error: " + error)).appendResp(&out, client->protover);
+            } else {
+                out.append(Reply::error(DBStatus::IOError("Protocol error: " + error)).toSlice());
+                out.appendStatic("\r\n", 2);
             }
-
-            std::string str;
-            // 存储RDB头
-            str = saveHead();
-            for (int i = 0; i < DEFAULT_DB_NUM; ++i) {
-                if (database_[i]->getKeySize() == 0) {
-                    continue;
-                }
-                str += saveSelectDB(i);
-                // String
-                if (database_[i]->getKeyStringSize() != 0) {
-                    str += saveType(kvDB::dbString);
-                    auto obj = database_[i]->getKeyStringObj();
-                    for (auto& it : obj) {
-                        str += saveExpiredTime(database_[i]->getKeyExpiredTime(kvDB::dbString, it.first));
-                        str += saveKV(it.first, it.second);
-                    }
-                }
-                // List
-                if (database_[i]->getKeyListSize() != 0) {
-                    str += saveType(kvDB::dbList);
-                    auto it = database_[i]->getKeyListObj().begin();
-                    for (; it != database_[i]->getKeyListObj().end(); it++) {
-                        str += saveExpiredTime(database_[i]->getKeyExpiredTime(kvDB::dbList, it->first));
-                        auto iter = it->second.begin();
-                        std::string tmp = '!' + std::to_string(it->second.size());
-                        for (; iter != it->second.end(); iter++) {
-                            tmp += '!' + std::to_string(iter->size()) + '$' + iter->c_str();
-                        }
-                        str += '!' + std::to_string(it->first.size()) + '#' + it->first.c_str() + tmp;
-                    }
-                }
-                // Hash
-                if (database_[i]->getKeyHashSize() != 0) {
-                    str += saveType(kvDB::dbHash);
-                    auto it = database_[i]->getKeyHashObj().begin();
-                    for (; it != database_[i]->getKeyHashObj().end(); it++) {
-                        str += saveExpiredTime(database_[i]->getKeyExpiredTime(kvDB::dbHash, it->first));
-                        auto iter = it->second.begin();
-                        std::string tmp = '!' + std::to_string(it->second.size());
-                        for (; iter != it->second.end(); iter++) {
-                            tmp += saveKV(iter->first, iter->second);
-                        }
-                        str += '!' + std::to_string(it->first.size()) + '#' + it->first.c_str() + tmp;
-                    }
+        };
+        while (buf->readableBytes() > 0) {
+            if (commands >= commandBudget_ || bytes >= byteBudget_) {
+                conn->deferMessage();
+                break;
+            }
+            /* 命令执行完之后才从buf中取走frameLen字节，执行时参数一直指向buf */
+            size_t frameLen = 0;
+            const bool resp = client->parser.accept(buf);
+            if (resp) {
+                RespParser::Result res = client->parser.parse(buf, &argv, &frameLen);
+                if (res == RespParser::kIncomplete) {
+                    // 不完整的请求留在buf中，解析器记录了解析到的位置，等待下次读到数据
+                    break;
                 }
-                // Set
-                if (database_[i]->getKeySetSize() != 0) {
-                    str += saveType(kvDB::dbSet);
-                    auto it = database_[i]->getKeySetObj().begin();
-                    for (; it != database_[i]->getKeySetObj().end(); it++) {
-                        str += saveExpiredTime(database_[i]->getKeyExpiredTime(kvDB::dbSet, it->first));
-                        auto iter = it->second.begin();
-                        std::string tmp = '!' + std::to_string(it->second.size());
-                        for (; iter != it->second.end(); iter++) {
-                            tmp += '!' + std::to_string(iter->size()) + '$' + iter->c_str();
-                        }
-                        str += '!' + std::to_string(it->first.size()) + '#' + it->first.c_str() + tmp;
-                    }
+                if (res == RespParser::kError) {
+                    protocolError(true, client->parser.error());
+                    break;
                 }
-                // ZSet
-                if(database_[i]->getKeyZSetSize() != 0){
-                    str += saveType(kvDB::dbZSet);
-                    auto it = database_[i]->getKeyZSetObj().begin();
-                    for(; it != database_[i]->getKeyZSetObj().end(); it++){
-                        str += saveExpiredTime(database_[i]->getKeyExpiredTime(kvDB::dbZSet,it->first));
-                        std::string tmp = '!' + std::to_string(it->second->getLength());
-                        RangeSpec spec(DBL_MIN,DBL_MAX);
-                        std::vector<SkipListNode*> vecSkip(it->second->getNodeInRange(spec));
-                        for(auto& j : vecSkip){
-                            tmp+= saveKV(j->obj_, std::to_string(j->score_));
-                        }
-                        str += '!' + std::to_string(it->first.size()) + '#' + it->first.c_str() + tmp;
+            } else {
+                // 一行是一条命令，行尾可以是\n或者\r\n
+                const char* eol = buf->findEOL();
+                if (eol == nullptr) {
+                    if (buf->readableBytes() > kMaxInlineLen) {
+                        protocolError(false, "too big inline request");
                     }
+                    // 不完整的命令留在buf中，等待下次读到数据
+                    break;
                 }
-                str.append("EOF");
-                out.write(str.c_str(), str.size());
+                const char* end = eol > buf->peek() && eol[-1] == '\r' ? eol - 1 : eol;
+                argv.split(std::string_view(buf->peek(), static_cast<size_t>(end - buf->peek())));
+                frameLen = static_cast<size_t>(eol + 1 - buf->peek());
             }
-            out.close();
-            exit(0);
-        } else if (pid > 0) {
-            LOG_INFO("parent process");
-        } else {
-            LOG_ERROR("fork error");
+            bytes += frameLen;
+            if (argv.empty()) {
+                // 跳过空行和空的请求
+                buf->retrieve(frameLen);
+                continue;
+            }
+            ++commands;
+            if (threadedIo_) {
+                // 只前移读位置，数据留在buf的内存块中，切分完之后整体交给batch
+                batch.add(resp, argv, buf->peek());
+                buf->retrieve(frameLen);
+                continue;
+            }
+            Reply res;
+            {
+                std::lock_guard<std::mutex> lock(dbMutex_);
+                res = execute(client, argv, resp, overloaded);
+            }
+            buf->retrieve(frameLen);
+            if (resp) {
+                std::move(res).appendResp(&out, client->protover);
+            } else {
+                out.append(std::move(res).toSlice());
+                out.appendStatic("\r\n", 2);
+            }
+        }
+        if (threadedIo_) {
+            if (!batch.commands.empty()) {
+                batch.takeInput(buf);
+            }
+            if (!batch.commands.empty() || !batch.protocolError.empty()) {
+                loop_->queueInLoop([this, conn, batch = std::move(batch)]() mutable { executeBatch(conn, batch); });
+            }
+            return;
+        }
+        if (!out.empty()) {
+            conn->send(std::move(out));
+        }
+        if (client->protocolError) {
+            // 发送完错误之后关闭连接
+            conn->shutdown();
         }
     }
 
-    // 解析命令
-    std::string DBServer::parseMsg(const std::string& msg) {
-        std::string res;
-        std::istringstream ss(msg);
-        std::string cmd, key, objKey, objValue;
-
-        ss >> cmd;
-        if (cmd.empty()) {
-            return DBStatus::notFound(" ").toString();
+    void DBServer::Batch::takeInput(Buffer* buf) {
+        const auto consumed = static_cast<size_t>(buf->peek() - base);
+        input = std::make_shared<Buffer>();
+        if (buf->readableBytes() <= consumed) {
+            /* 整个内存块交给batch，只把还没有切分的数据(一般是不完整的命令)拷回连接的Buffer.
+             * 解析器记录的偏移相对于peek()，拷贝之后仍然有效 */
+            input->swap(*buf);
+            buf->append(input->peek(), input->readableBytes());
+        } else {
+            // 预算用完时剩下的数据比已经切分的多，只拷贝已经切分的命令
+            input->append(base, consumed);
+            base = input->peek();
         }
-        if (cmd == "set") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                ss >> key;
-                ss >> objKey;
-                VctS vs = {cmd, key, objKey};
-                res = it->second(std::move(vs));
-            }
-        } else if (cmd == "get") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                ss >> key;
-                VctS vs = {cmd, key};
-                res = it->second(std::move(vs));
+    }
+
+    void DBServer::executeBatch(const TcpConnectionPtr& conn, Batch& batch) {
+        /* 在baseLoop中串行执行，threaded-io模式下所有访问database_的代码都在baseLoop中，不需要加锁.
+         * 回复按顺序打包交回连接所属的subLoop，由它编码和写socket */
+        auto* client = std::any_cast<ClientState>(conn->getMutableContext());
+        assert(client != nullptr);
+        std::vector<Output> outputs;
+        outputs.reserve(batch.commands.size() + 1);
+        const bool overloaded = loopOverloaded(loop_);
+        CommandArgs argv;
+        for (const Batch::Command& command : batch.commands) {
+            argv.clear();
+            for (size_t i = 0; i < command.argc; ++i) {
+                const auto& arg = batch.args[command.firstArg + i];
+                argv.push_back(std::string_view(batch.base + arg.first, arg.second));
             }
-        } else if (cmd == "pexpire") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                ss >> key;
-                ss >> objKey;
-                VctS vs = {cmd, key, objKey};
-                res = it->second(std::move(vs));
+            Reply reply = execute(client, argv, command.resp, overloaded);
+            /* 协议版本在执行之后读取，HELLO的回复已经是新的版本 */
+            outputs.push_back(Output{std::move(reply), command.resp ? client->protover : 0});
+        }
+        const bool shutdown = !batch.protocolError.empty();
+        if (shutdown) {
+            outputs.push_back(Output{Reply::error(DBStatus::IOError("Protocol error: " + batch.protocolError)),
+                                     batch.protocolErrorResp ? client->protover : 0});
+        }
+        /* input随回调交回subLoop，在那里释放，内存块回到分配它的线程的BufferPool */
+        conn->getLoop()->queueInLoop([conn, outputs = std::move(outputs), input = std::move(batch.input),
+                                      shutdown]() mutable {
+            OutputChain out;
+            for (Output& output : outputs) {
+                if (output.protover > 0) {
+                    std::move(output.reply).appendResp(&out, output.protover);
+                } else {
+                    out.append(std::move(output.reply).toSlice());
+                    out.appendStatic("\r\n", 2);
+                }
             }
-        } else if (cmd == "expire") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                ss >> key;
-                ss >> objKey;
-                VctS vs = {cmd, key, objKey};
-                res = it->second(std::move(vs));
+            conn->send(std::move(out));
+            if (shutdown) {
+                conn->shutdown();
             }
-        } else if (cmd == "bgsave") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                VctS vs = {cmd};
-                res = it->second(std::move(vs));
+            input.reset();
+        });
+    }
+
+    /* 非空槽的个数 */
+    template<size_t N>
+    static constexpr size_t usedSlots(const std::array<uint8_t, N>& index) {
+        size_t used = 0;
+        for (uint8_t slot : index) {
+            used += slot != 0;
+        }
+        return used;
+    }
+
+    const DBServer::Command* DBServer::lookupCommand(std::string_view name) {
+        static_assert(usedSlots(kCommandIndex) == std::size(kCommands),
+                      "commandHash() has collisions, adjust its coefficients or kCommandSlots");
+        if (name.empty()) {
+            return nullptr;
+        }
+        uint8_t slot = kCommandIndex[commandHash(name)];
+        if (slot == 0) {
+            return nullptr;
+        }
+        const Command* cmd = &kCommands[slot - 1];
+        if (cmd->name.size() != name.size()) {
+            return nullptr;
+        }
+        for (size_t i = 0; i < name.size(); ++i) {
+            if (::tolower(static_cast<unsigned char>(name[i])) != cmd->name[i]) {
+                return nullptr;
             }
-        } else if (cmd == "select") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
+        }
+        return cmd;
+    }
+
+    Reply DBServer::execute(ClientState* client, const CommandArgs& argv, bool resp, bool overloaded) {
+        const Command* cmd = lookupCommand(argv[0]);
+        if (cmd == nullptr || (!resp && (cmd->flags & kCmdRespOnly))) {
+            std::string name(argv[0]);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            return Reply::error(DBStatus::notFound("command '" + name + "'"))
+                    .withText(DBStatus::notFound("command").toString());
+        }
+        if (overloaded && (cmd->flags & kCmdWrite)) {
+            return busyReply();
+        }
+        if (!cmd->checkArity(argv.size())) {
+            return Reply::error(DBStatus::IOError("Parameter error"));
+        }
+        return (this->*cmd->handler)(client, argv);
+    }
+
+    bool DBServer::loopOverloaded(EventLoop* loop) const {
+        int64_t threshold = lagThresholdUs_.load(std::memory_order_relaxed);
+        return threshold > 0 && loop->lagUs() > threshold;
+    }
+
+    Reply DBServer::busyReply() {
+        rejectedWrites_.fetch_add(1, std::memory_order_relaxed);
+        return Reply::error(DBStatus::busy("server is overloaded, try again later"));
+    }
+
+    void DBServer::configure(const Config& config) {
+        int ioThreads = static_cast<int>(config.getInt("io-threads", 0));
+        server_.setThreadNum(ioThreads);
+        threadedIo_ = ioThreads > 0 && config.getBool("threaded-io", false);
+        std::string cpuList = config.getString("io-threads-cpulist", "");
+        if (!cpuList.empty()) {
+            std::vector<int> cpus;
+            if (parseCpuList(cpuList, &cpus)) {
+                server_.setThreadCpus(std::move(cpus));
             } else {
-                ss >> key;
-                VctS vs = {cmd, key};
-                res = it->second(std::move(vs));
+                LOG_ERROR("invalid io-threads-cpulist %s\n", cpuList.c_str());
             }
-        } else if (cmd == "rpush") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                ss >> key;
-                while (ss >> objKey) {
-                    VctS vs = {cmd, key, objKey};
-                    res = it->second(std::move(vs));
-                }
+        }
+        std::string balance = config.getString("loop-balance", "round-robin");
+        if (balance == "least-connections") {
+            server_.setLoadBalance(Server::kLeastConnections);
+        } else if (balance == "incoming-cpu") {
+            server_.setLoadBalance(Server::kIncomingCpu);
+        } else {
+            server_.setLoadBalance(Server::kRoundRobin);
+        }
+        server_.setEdgeTriggered(config.getBool("epoll-et", false));
+        server_.setCoalesceReplies(config.getBool("coalesce-replies", true));
+        server_.setBusyPoll(config.getInt("busy-poll", 0),
+                            static_cast<int>(config.getInt("socket-busy-poll", 0)));
+        server_.setIdleTimeout(static_cast<double>(config.getInt("timeout", 0)));
+        server_.setAcceptBudget(static_cast<int>(config.getInt("accept-budget", 64)));
+        server_.setListenBacklog(static_cast<int>(config.getInt("tcp-backlog", 1024)));
+        server_.setDeferAccept(static_cast<int>(config.getInt("tcp-defer-accept", 0)));
+        applyTunables(config);
+        std::string unixSocket = config.getString("unixsocket", "");
+        if (!unixSocket.empty()) {
+            /* 权限按八进制解析，如 700 */
+            auto perm = static_cast<mode_t>(strtol(config.getString("unixsocketperm", "0").c_str(), nullptr, 8));
+            server_.listenUnix(unixSocket, perm);
+        }
+        config_ = config;
+    }
+
+    void DBServer::applyTunables(const Config& config) {
+        std::string logFile = config.getString("logfile", "");
+        if (!Singleton_Logger::GetInstance()->setLogFile(logFile)) {
+            LOG_ERROR("open logfile %s failed\n", logFile.c_str());
+        }
+        size_t highWaterMark = config.getBytes("output-high-watermark", 1024 * 1024);
+        size_t lowWaterMark = config.getBytes("output-low-watermark", 256 * 1024);
+        /* 低水位不小于高水位时，同一次写就会暂停又恢复读取，水位不起作用；按默认的比例改为高水位的1/4 */
+        if (highWaterMark > 0 && lowWaterMark >= highWaterMark) {
+            LOG_WARN("output-low-watermark %zu must be less than output-high-watermark %zu, using %zu\n",
+                     lowWaterMark, highWaterMark, highWaterMark / 4);
+            lowWaterMark = highWaterMark / 4;
+        }
+        server_.setOutputWaterMarks(highWaterMark, lowWaterMark);
+        server_.setOutputLimit(config.getBytes("client-output-limit", 0));
+        server_.setZeroCopyThreshold(config.getBytes("zerocopy-threshold", 0));
+        commandBudget_ = static_cast<size_t>(std::max(config.getInt("event-command-budget", 256), 1L));
+        byteBudget_ = std::max(config.getBytes("event-byte-budget", 1024 * 1024), static_cast<size_t>(1));
+        lagThresholdUs_ = config.getInt("loop-lag-threshold", 0) * 1000;
+        server_.setLoopLagThreshold(lagThresholdUs_);
+
+        double saveInterval = static_cast<double>(config.getInt("save-interval", 0));
+        double statsInterval = static_cast<double>(config.getInt("stats-interval", 0));
+        bool timersChanged = saveInterval != saveInterval_ || statsInterval != statsInterval_;
+        saveInterval_ = saveInterval;
+        statsInterval_ = statsInterval;
+        if (started_ && timersChanged) {
+            startTimers();
+        }
+    }
+
+    void DBServer::start() {
+        /* 信号处理必须在创建io线程之前注册，io线程继承屏蔽的信号集，信号只从baseLoop的signalfd中读出 */
+        loop_->handleSignal(SIGCHLD, std::bind(&DBServer::reapChildren, this));
+        loop_->handleSignal(SIGTERM, std::bind(&DBServer::shutdown, this, std::placeholders::_1));
+        loop_->handleSignal(SIGINT, std::bind(&DBServer::shutdown, this, std::placeholders::_1));
+        loop_->handleSignal(SIGHUP, std::bind(&DBServer::reload, this));
+        server_.start();
+        started_ = true;
+        startTimers();
+    }
+
+    void DBServer::startTimers() {
+        loop_->cancel(saveTimer_);
+        loop_->cancel(statsTimer_);
+        saveTimer_ = TimerId();
+        statsTimer_ = TimerId();
+        if (saveInterval_ > 0.0) {
+            saveTimer_ = loop_->runEvery(saveInterval_, std::bind(&DBServer::serverCron, this));
+        }
+        if (statsInterval_ > 0.0) {
+            statsTimer_ = loop_->runEvery(statsInterval_, std::bind(&DBServer::logStats, this));
+        }
+    }
+
+    void DBServer::reapChildren() {
+        int status = 0;
+        pid_t pid;
+        while ((pid = ::waitpid(-1, &status, WNOHANG)) > 0) {
+            std::lock_guard<std::mutex> lock(dbMutex_);
+            if (pid != childPid_) {
+                LOG_INFO("child %d exited\n", pid);
+                continue;
             }
-        } else if (cmd == "rpop") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                ss >> key;
-                VctS vs = {cmd, key};
-                res = it->second(std::move(vs));
+            double ms = static_cast<double>((Timestamp::now() - childStart_).microSecondsSinceEpoch()) / 1000.0;
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+                LOG_INFO("Background saving terminated with success in %.1fms\n", ms);
+            } else if (WIFEXITED(status)) {
+                LOG_ERROR("Background saving error, exit status %d after %.1fms\n", WEXITSTATUS(status), ms);
+            } else if (WIFSIGNALED(status)) {
+                LOG_ERROR("Background saving terminated by signal %d after %.1fms\n", WTERMSIG(status), ms);
             }
-        } else if (cmd == "hset") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                ss >> key;
-                ss >> objKey;
-                ss >> objValue;
-                VctS vs = {cmd, key, objKey, objValue};
-                res = it->second(std::move(vs));
+            childPid_ = -1;
+        }
+    }
+
+    void DBServer::shutdown(int signo) {
+        LOG_INFO("Received %s, shutting down\n", signo == SIGINT ? "SIGINT" : "SIGTERM");
+        {
+            /* 拿到锁之后io线程中不会有正在执行的命令，保存的是一致的快照 */
+            std::lock_guard<std::mutex> lock(dbMutex_);
+            if (childPid_ > 0) {
+                LOG_INFO("Killing background saving child %d\n", childPid_);
+                ::kill(childPid_, SIGKILL);
+                ::waitpid(childPid_, nullptr, 0);
+                ::unlink((rdbFilePath() + ".tmp." + std::to_string(childPid_)).c_str());
+                childPid_ = -1;
             }
-        } else if (cmd == "hget") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                ss >> key;
-                ss >> objKey;
-                VctS vs = {cmd, key, objKey};
-                res = it->second(std::move(vs));
+            if (saveInterval_ > 0.0) {
+                std::string path = rdbFilePath();
+                std::string tmp = path + ".tmp." + std::to_string(getpid());
+                if (rdbSaveToFile(tmp) && ::rename(tmp.c_str(), path.c_str()) == 0) {
+                    LOG_INFO("DB saved on disk\n");
+                } else {
+                    ::unlink(tmp.c_str());
+                    LOG_ERROR("Error trying to save the DB on shutdown\n");
+                }
             }
-        } else if (cmd == "hgetall") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                ss >> key;
-                VctS vs = {cmd, key};
-                res = it->second(std::move(vs));
+        }
+        /* 退出loop后Server析构，关闭监听fd，删除Unix域套接字文件 */
+        loop_->quit();
+    }
+
+    void DBServer::reload() {
+        LOG_INFO("Received SIGHUP, reopening logfile and reloading %s\n", config_.path().c_str());
+        Singleton_Logger::GetInstance()->reopen();
+        if (!config_.reload()) {
+            LOG_ERROR("reload %s failed, keep the old config\n", config_.path().c_str());
+            return;
+        }
+        applyTunables(config_);
+    }
+
+    void DBServer::logStats() {
+        Acceptor::Stats stats = server_.acceptStats();
+        LOG_INFO("accept: %lu connections in %lu wakeups, %.2f per wakeup, max %lu, budget exhausted %lu\n",
+                 stats.accepted, stats.wakeups,
+                 stats.wakeups == 0 ? 0.0 : static_cast<double>(stats.accepted) / static_cast<double>(stats.wakeups),
+                 stats.maxPerWakeup, stats.budgetExhausted);
+        EventLoop::PollStats poll = server_.pollStats();
+        LOG_INFO("poll: %lu spins (%.1f%% hit), %lu sleeps, spin/sleep %.2f\n",
+                 poll.spins, poll.spins == 0 ? 0.0 : 100.0 * static_cast<double>(poll.spinHits) / static_cast<double>(poll.spins),
+                 poll.sleeps, poll.sleeps == 0 ? 0.0 : static_cast<double>(poll.spins) / static_cast<double>(poll.sleeps));
+        uint64_t iterations = poll.spins + poll.sleeps;
+        LOG_INFO("loop lag: current %ldus, max %ldus, avg %.1fus; shed: accept paused %lu, writes rejected %lu\n",
+                 server_.maxLoopLagUs(), poll.maxLagUs,
+                 iterations == 0 ? 0.0 : static_cast<double>(poll.totalLagUs) / static_cast<double>(iterations),
+                 stats.paused, rejectedWrites_.load(std::memory_order_relaxed));
+    }
+
+    void DBServer::serverCron() {
+        std::lock_guard<std::mutex> lock(dbMutex_);
+        checkSaveCondition();
+    }
+
+    std::string DBServer::rdbFilePath() {
+        char buf[1024]{0};
+        std::string path = getcwd(buf, 1024);
+        assert(!path.empty());
+        return path + "/dump.rdb";
+    }
+
+    void DBServer::rdbSave() {
+        pid_t pid = fork();
+        if (pid == 0) {
+            /* 子进程中不写日志：fork时其他线程可能正持有日志的锁。
+             * 先写到临时文件再rename，保存失败或被杀死时不会破坏上一次的dump.rdb；
+             * 用_exit退出，不执行从父进程继承的静态对象析构和atexit */
+            std::string path = rdbFilePath();
+            std::string tmp = path + ".tmp." + std::to_string(getpid());
+            bool ok = rdbSaveToFile(tmp) && ::rename(tmp.c_str(), path.c_str()) == 0;
+            if (!ok) {
+                ::unlink(tmp.c_str());
             }
-        } else if (cmd == "sadd") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                ss >> key;
-                ss >> objKey;
-                VctS vs = {cmd, key, objKey};
-                res = it->second(std::move(vs));
+            _exit(ok ? 0 : 1);
+        } else if (pid > 0) {
+            LOG_INFO("Background saving started by pid %d\n", pid);
+            childPid_ = pid;
+            childStart_ = Timestamp::now();
+        } else {
+            LOG_ERROR("fork error: %d\n", errno);
+        }
+    }
+
+    bool DBServer::rdbSaveToFile(const std::string& path) {
+        std::ofstream out;
+        out.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!out.is_open()) {
+            return false;
+        }
+
+        /* 序列化的数据攒到一定大小就写到文件，不在内存中拼出整个文件 */
+        static const size_t kFlushSize = 64 * 1024;
+        std::string str;
+        auto flush = [&out, &str](bool force) {
+            if (force || str.size() >= kFlushSize) {
+                out.write(str.data(), static_cast<std::streamsize>(str.size()));
+                str.clear();
             }
-        } else if (cmd == "smembers") {
-            auto it = cmdDict.find(cmd);
-            if (it == cmdDict.end()) {
-                return DBStatus::notFound("command").toString();
-            } else {
-                ss >> key;
-                VctS vs = {cmd, key};
-                res = it->second(std::move(vs));
+        };
+        // 存储RDB头
+        saveHead(&str);
+        for (int i = 0; i < DEFAULT_DB_NUM; ++i) {
+            if (database_[i]->getKeySize() == 0) {
+                continue;
             }
-        } else if(cmd == "zadd") {
-            auto it = cmdDict.find(cmd);
-            if(it == cmdDict.end()){
-                return DBStatus::notFound("command").toString();
-            }else{
-                ss >> key;
-                ss >> objKey;
-                ss >> objValue;
-                VctS vs = {cmd,key,objKey,objValue};
-                res = it->second(std::move(vs));
+            saveSelectDB(&str, i);
+            // String
+            if (database_[i]->getKeyStringSize() != 0) {
+                saveType(&str, kvDB::dbString);
+                for (const auto& it : database_[i]->getKeyStringObj()) {
+                    saveExpiredTime(&str, database_[i]->getKeyExpiredTime(kvDB::dbString, it.first));
+                    saveString(&str, it.first);
+                    saveString(&str, *it.second);
+                    flush(false);
+                }
             }
-        }else if(cmd == "zcard"){
-            auto it = cmdDict.find(cmd);
-            if(it == cmdDict.end()){
-                return DBStatus::notFound("command").toString();
-            }else{
-                ss >> key;
-                VctS vs = {cmd,key};
-                res = it->second(std::move(vs));
+            // List
+            if (database_[i]->getKeyListSize() != 0) {
+                saveType(&str, kvDB::dbList);
+                for (const auto& it : database_[i]->getKeyListObj()) {
+                    saveExpiredTime(&str, database_[i]->getKeyExpiredTime(kvDB::dbList, it.first));
+                    saveString(&str, it.first);
+                    saveCount(&str, it.second.size());
+                    for (const auto& value : it.second) {
+                        saveString(&str, value);
+                        flush(false);
+                    }
+                }
             }
-        }else if(cmd == "zrange") {
-            auto it = cmdDict.find(cmd);
-            if(it == cmdDict.end()){
-                return DBStatus::notFound("command").toString();
-            }else{
-                ss >> key;
-                ss >> objKey;   // range start
-                ss >> objValue; // range end
-                VctS vs = {cmd,key,objKey,objValue};
-                res = it->second(std::move(vs));
+            // Hash
+            if (database_[i]->getKeyHashSize() != 0) {
+                saveType(&str, kvDB::dbHash);
+                for (const auto& it : database_[i]->getKeyHashObj()) {
+                    saveExpiredTime(&str, database_[i]->getKeyExpiredTime(kvDB::dbHash, it.first));
+                    saveString(&str, it.first);
+                    saveCount(&str, it.second.size());
+                    for (const auto& field : it.second) {
+                        saveString(&str, field.first);
+                        saveString(&str, field.second);
+                        flush(false);
+                    }
+                }
             }
-        }else if(cmd == "zcount"){
-            auto it = cmdDict.find(cmd);
-            if(it == cmdDict.end()){
-                return DBStatus::notFound("command").toString();
-            }else{
-                ss >> key;
-                ss >> objKey;   // range start
-                ss >> objValue; // range end
-                VctS vs = {cmd,key,objKey,objValue};
-                res = it->second(std::move(vs));
+            // Set
+            if (database_[i]->getKeySetSize() != 0) {
+                saveType(&str, kvDB::dbSet);
+                for (const auto& it : database_[i]->getKeySetObj()) {
+                    saveExpiredTime(&str, database_[i]->getKeyExpiredTime(kvDB::dbSet, it.first));
+                    saveString(&str, it.first);
+                    saveCount(&str, it.second.size());
+                    for (const auto& member : it.second) {
+                        saveString(&str, member);
+                        flush(false);
+                    }
+                }
             }
-        }else if(cmd == "zgetall"){
-            auto it = cmdDict.find(cmd);
-            if(it == cmdDict.end()){
-                return DBStatus::notFound("command").toString();
-            }else{
-                ss >> key;
-                VctS vs = {cmd,key};
-                res = it->second(std::move(vs));
+            // ZSet
+            if (database_[i]->getKeyZSetSize() != 0) {
+                saveType(&str, kvDB::dbZSet);
+                for (const auto& it : database_[i]->getKeyZSetObj()) {
+                    saveExpiredTime(&str, database_[i]->getKeyExpiredTime(kvDB::dbZSet, it.first));
+                    saveString(&str, it.first);
+                    RangeSpec spec(-DBL_MAX, DBL_MAX);
+                    std::vector<SkipListNode*> nodes(it.second->getNodeInRange(spec));
+                    saveCount(&str, nodes.size());
+                    for (SkipListNode* node : nodes) {
+                        saveString(&str, node->obj_);
+                        saveString(&str, scoreToString(node->score_));
+                        flush(false);
+                    }
+                }
             }
-        }else{
-            return DBStatus::notFound("command").toString();
         }
-        return res;
+        str.append("EOF");
+        flush(true);
+        out.close();
+        return !out.fail();
+    }
+
+    /* 解析整数，不是完整的数字时返回false */
+    static bool parseInteger(std::string_view str, long* value) {
+        auto res = std::from_chars(str.data(), str.data() + str.size(), *value);
+        return !str.empty() && res.ec == std::errc() && res.ptr == str.data() + str.size();
+    }
+
+    /* 解析浮点数(允许前面的'+'，如 +inf)，不是完整的数字时返回false */
+    static bool parseDouble(std::string_view str, double* value) {
+        if (!str.empty() && str[0] == '+') {
+            str.remove_prefix(1);
+        }
+        auto res = std::from_chars(str.data(), str.data() + str.size(), *value);
+        return !str.empty() && res.ec == std::errc() && res.ptr == str.data() + str.size();
+    }
+
+    Reply DBServer::helloCommand(ClientState* client, const CommandArgs& argv) {
+        if (argv.size() >= 2) {
+            long protover = 0;
+            if (!parseInteger(argv[1], &protover) || (protover != 2 && protover != 3)) {
+                return Reply::error(DBStatus::IOError("unsupported protocol version"));
+            }
+            client->protover = static_cast<int>(protover);
+        }
+        // AUTH和SETNAME参数忽略
+        std::vector<Reply> fields;
+        fields.push_back(Reply::bulk("server"));
+        fields.push_back(Reply::bulk("kvdb"));
+        fields.push_back(Reply::bulk("version"));
+        fields.push_back(Reply::bulk("1.0.0"));
+        fields.push_back(Reply::bulk("proto"));
+        fields.push_back(Reply::integer(client->protover));
+        fields.push_back(Reply::bulk("mode"));
+        fields.push_back(Reply::bulk("standalone"));
+        fields.push_back(Reply::bulk("role"));
+        fields.push_back(Reply::bulk("master"));
+        fields.push_back(Reply::bulk("modules"));
+        fields.push_back(Reply::array({}));
+        return Reply::map(std::move(fields));
     }
 
-    // Vcts[0]: set  Vects[1]: 要操作的key
-    std::string DBServer::setCommand(VctS&& argv) {
-        if (argv.size() != 3) {
-            return DBStatus::IOError("Parameter error").toString();
+    Reply DBServer::pingCommand(ClientState*, const CommandArgs& argv) {
+        if (argv.size() == 1) {
+            return Reply::status("PONG");
         }
+        if (argv.size() == 2) {
+            return Reply::bulk(std::string(argv[1]));
+        }
+        return Reply::error(DBStatus::IOError("Parameter error"));
+    }
+
+    // argv[0]: set  argv[1]: 要操作的key  argv[2]: value
+    Reply DBServer::setCommand(ClientState*, const CommandArgs& argv) {
+        const std::string key(argv[1]);
         // 处理过期时间
-        bool expired = database_[dbIndex]->judgeKeyExpiredTime(kvDB::dbString, argv[1]);
+        bool expired = database_[dbIndex]->judgeKeyExpiredTime(kvDB::dbString, key);
         if (expired) {
-            database_[dbIndex]->delKey(kvDB::dbString, argv[1]);
+            database_[dbIndex]->delKey(kvDB::dbString, key);
         }
 
-        bool res = database_[dbIndex]->addKey(kvDB::dbString, argv[1], argv[2], kvDB::defaultObjValue);
+        bool res = database_[dbIndex]->addKey(kvDB::dbString, key, std::string(argv[2]), kvDB::defaultObjValue);
 
-        return res ? DBStatus::Ok().toString() :
-               DBStatus::IOError("set error").toString();
+        return res ? Reply::status("OK") :
+               Reply::error(DBStatus::IOError("set error"));
     }
 
-    std::string DBServer::getCommand(VctS&& argv) {
-        if (argv.size() != 2) {
-            return DBStatus::IOError("Parameter error").toString();
-        }
+    Reply DBServer::getCommand(ClientState*, const CommandArgs& argv) {
+        const std::string key(argv[1]);
         // 处理过期时间
-        bool expired = database_[dbIndex]->judgeKeyExpiredTime(kvDB::dbString, argv[1]);
+        bool expired = database_[dbIndex]->judgeKeyExpiredTime(kvDB::dbString, key);
         if (expired) {
-            database_[dbIndex]->delKey(kvDB::dbString, argv[1]);
-            return DBStatus::IOError("Empty Content").toString();
+            database_[dbIndex]->delKey(kvDB::dbString, key);
+            return Reply::nil().withText(DBStatus::IOError("Empty Content").toString());
         }
 
-        std::string res = database_[dbIndex]->getKey(kvDB::dbString, argv[1]);
+        auto res = database_[dbIndex]->getStringValue(key);
+        if (!res) {
+            return Reply::nil().withText(DBStatus::notFound("key").toString());
+        }
 
-        return res.empty() ? DBStatus::IOError("Empty Content").toString() :
-               res;
+        return res->empty() ? Reply::bulk(std::string()).withText(DBStatus::IOError("Empty Content").toString()) :
+               Reply::bulk(std::move(res));
     }
 
-    std::string DBServer::pExpiredCommand(VctS &&argv) {
-        if (argv.size() != 3) {
-            return DBStatus::IOError("Parameter error").toString();
+    Reply DBServer::pExpiredCommand(ClientState*, const CommandArgs& argv) {
+        double ms = 0.0;
+        if (!parseDouble(argv[2], &ms)) {
+            return Reply::error(DBStatus::IOError("Parameter error"));
         }
+        const std::string key(argv[1]);
         // dbString
-        bool res = database_[dbIndex]->setPExpireTime(kvDB::dbString, argv[1], atof(argv[2].c_str()));
+        bool res = database_[dbIndex]->setPExpireTime(kvDB::dbString, key, ms);
         if (!res) {
             // dbList
-            res = database_[dbIndex]->setPExpireTime(kvDB::dbList, argv[1], atof(argv[2].c_str()));
+            res = database_[dbIndex]->setPExpireTime(kvDB::dbList, key, ms);
         }
         if(!res){
             // dbHash
-            res = database_[dbIndex]->setPExpireTime(kvDB::dbHash,argv[1],atof(argv[2].c_str()));
+            res = database_[dbIndex]->setPExpireTime(kvDB::dbHash, key, ms);
         }
         if(!res){
             // dbSet
-            res = database_[dbIndex]->setPExpireTime(kvDB::dbSet,argv[1],atof(argv[2].c_str()));
+            res = database_[dbIndex]->setPExpireTime(kvDB::dbSet, key, ms);
         }
         if(!res){
             // dbZSet
-            res = database_[dbIndex]->setPExpireTime(kvDB::dbZSet,argv[1],atof(argv[2].c_str()));
+            res = database_[dbIndex]->setPExpireTime(kvDB::dbZSet, key, ms);
         }
 
-        return res ? DBStatus::Ok().toString() :
-               DBStatus::IOError("pExpire error").toString();
+        // RESP中返回1表示设置成功，0表示key不存在
+        return res ? Reply::integer(1).withText(DBStatus::Ok().toString()) :
+               Reply::integer(0).withText(DBStatus::IOError("pExpire error").toString());
     }
 
-    std::string DBServer::expiredCommand(VctS &&argv) {
-        if (argv.size() != 3) {
-            return DBStatus::IOError("Parameter error").toString();
+    Reply DBServer::expiredCommand(ClientState*, const CommandArgs& argv) {
+        double seconds = 0.0;
+        if (!parseDouble(argv[2], &seconds)) {
+            return Reply::error(DBStatus::IOError("Parameter error"));
         }
+        const std::string key(argv[1]);
+        const double ms = seconds * Timestamp::kMicroSecondsPerMilliSecond;
         // dbString
-        bool res = database_[dbIndex]->setPExpireTime(kvDB::dbString, argv[1],
-                                                      atof(argv[2].c_str()) * Timestamp::kMicroSecondsPerMilliSecond);
+        bool res = database_[dbIndex]->setPExpireTime(kvDB::dbString, key, ms);
         if (!res) {
             // dbList
-            res = database_[dbIndex]->setPExpireTime(kvDB::dbList, argv[1],
-                                                     atof(argv[2].c_str()) * Timestamp::kMicroSecondsPerMilliSecond);
+            res = database_[dbIndex]->setPExpireTime(kvDB::dbList, key, ms);
         }
         if (!res) {
             //dbHash
-            res = database_[dbIndex]->setPExpireTime(kvDB::dbHash, argv[1],
-                                                     atof(argv[2].c_str()) * Timestamp::kMicroSecondsPerMilliSecond);
+            res = database_[dbIndex]->setPExpireTime(kvDB::dbHash, key, ms);
         }
         if (!res) {
             //dbSet
-            res = database_[dbIndex]->setPExpireTime(kvDB::dbSet, argv[1],
-                                                     atof(argv[2].c_str()) * Timestamp::kMicroSecondsPerMilliSecond);
+            res = database_[dbIndex]->setPExpireTime(kvDB::dbSet, key, ms);
         }
         if(!res){
             //dbZSet
-            res = database_[dbIndex]->setPExpireTime(kvDB::dbZSet,argv[1],
-                                                     atof(argv[2].c_str()) * Timestamp::kMicroSecondsPerMilliSecond);
+            res = database_[dbIndex]->setPExpireTime(kvDB::dbZSet, key, ms);
         }
-        return res ? DBStatus::Ok().toString() :
-               DBStatus::IOError("expire error").toString();
+        return res ? Reply::integer(1).withText(DBStatus::Ok().toString()) :
+               Reply::integer(0).withText(DBStatus::IOError("expire error").toString());
     }
 
-    std::string DBServer::bgsaveCommand(VctS &&argv) {
-        if (argv.size() != 1) {
-            return DBStatus::IOError("Parameter error").toString();
-        }
+    Reply DBServer::bgsaveCommand(ClientState*, const CommandArgs&) {
         bool res = checkSaveCondition();
-        return res ? DBStatus::Ok().toString() :
-               DBStatus::IOError("bgsave error").toString();
+        return res ? Reply::status("Background saving started").withText(DBStatus::Ok().toString()) :
+               Reply::error(DBStatus::IOError("bgsave error"));
     }
 
-    std::string DBServer::selectCommand(VctS &&argv) {
-        if (argv.size() != 2) {
-            return DBStatus::IOError("Parameter error").toString();
+    Reply DBServer::selectCommand(ClientState*, const CommandArgs& argv) {
+        // 数据库的编号从1开始
+        long idx = 0;
+        if (!parseInteger(argv[1], &idx) || idx < 1 || idx > DEFAULT_DB_NUM) {
+            return Reply::error(DBStatus::IOError("DB index is out of range"));
         }
-        int idx = atoi(argv[1].c_str());
-        dbIndex = idx - 1;
+        dbIndex = static_cast<int>(idx - 1);
         database_[dbIndex]->rdbLoad(dbIndex);   // 加载rdb文件
-        return DBStatus::Ok().toString();
+        return Reply::status("OK");
     }
 
-    std::string DBServer::rpushCommand(VctS &&argv) {
-        if (argv.size() < 3) {
-            return DBStatus::IOError("Parameter error").toString();
+    Reply DBServer::rpushCommand(ClientState*, const CommandArgs& argv) {
+        const std::string key(argv[1]);
+        bool flag = true;
+        for (size_t i = 2; i < argv.size(); i++) {
+            flag = database_[dbIndex]->addKey(kvDB::dbList, key, std::string(argv[i]), kvDB::defaultObjValue);
         }
-        int flag;
-        for (int i = 2; i < argv.size(); i++) {
-            flag = database_[dbIndex]->addKey(kvDB::dbList, argv[1], argv[i], kvDB::defaultObjValue);
+        if (!flag) {
+            return Reply::error(DBStatus::IOError("rpush error"));
         }
-
-        return flag ? DBStatus::Ok().toString() : DBStatus::IOError("rpush error").toString();
+        // RESP中返回push之后列表的长度
+        auto& lists = database_[dbIndex]->getKeyListObj();
+        auto it = lists.find(key);
+        return Reply::integer(it == lists.end() ? 0 : static_cast<int64_t>(it->second.size()))
+                .withText(DBStatus::Ok().toString());
     }
 
-    std::string DBServer::rpopCommand(VctS &&argv) {
-        if (argv.size() != 2) {
-            return DBStatus::IOError("Parameter error").toString();
-        }
+    Reply DBServer::rpopCommand(ClientState*, const CommandArgs& argv) {
+        const std::string key(argv[1]);
         // 处理过期时间
-        bool expired = database_[dbIndex]->judgeKeyExpiredTime(kvDB::dbList, argv[1]);
+        bool expired = database_[dbIndex]->judgeKeyExpiredTime(kvDB::dbList, key);
         if (expired) {
-            database_[dbIndex]->delKey(kvDB::dbList, argv[1]);
-            return DBStatus::IOError("Empty Content").toString();
+            database_[dbIndex]->delKey(kvDB::dbList, key);
+            return Reply::nil().withText(DBStatus::IOError("Empty Content").toString());
         }
 
-        std::string res = database_[dbIndex]->rpopList(argv[1]);
+        std::string res = database_[dbIndex]->rpopList(key);
         if (res.empty()) {
-            return DBStatus::IOError("rpop error").toString();
+            return Reply::nil().withText(DBStatus::IOError("rpop error").toString());
         } else {
-            return res;
+            return Reply::bulk(std::move(res));
         }
     }
 
-    std::string DBServer::hsetCommand(VctS &&argv) {
-        if (argv.size() != 4) {
-            return DBStatus::IOError("Parameter error").toString();
-        }
-        bool flag = database_[dbIndex]->addKey(kvDB::dbHash, argv[1], argv[2], argv[3]);
-
-        return flag ? DBStatus::Ok().toString() : DBStatus::IOError("hset error").toString();
+    Reply DBServer::hsetCommand(ClientState*, const CommandArgs& argv) {
+        const std::string key(argv[1]);
+        std::string field(argv[2]);
+        // RESP中返回新增的field数
+        auto& hashes = database_[dbIndex]->getKeyHashObj();
+        auto it = hashes.find(key);
+        bool added = it == hashes.end() || it->second.find(field) == it->second.end();
+        bool flag = database_[dbIndex]->addKey(kvDB::dbHash, key, std::move(field), std::string(argv[3]));
+
+        return flag ? Reply::integer(added ? 1 : 0).withText(DBStatus::Ok().toString()) :
+               Reply::error(DBStatus::IOError("hset error"));
     }
 
-    std::string DBServer::hgetCommand(VctS &&argv) {
-        if (argv.size() != 3) {
-            return DBStatus::IOError("Parameter error").toString();
-        }
-        auto tmp = database_[dbIndex]->getKeyHashObj();
-        auto it = tmp.find(argv[1]);
+    Reply DBServer::hgetCommand(ClientState*, const CommandArgs& argv) {
+        auto& tmp = database_[dbIndex]->getKeyHashObj();
+        auto it = tmp.find(std::string(argv[1]));
         if (it == tmp.end()) {
-            return DBStatus::notFound("Empty Content").toString();
+            return Reply::nil().withText(DBStatus::notFound("Empty Content").toString());
         } else {
+            // field的map使用std::less<>，可以直接用string_view查找
             auto iter = it->second.find(argv[2]);
             if (iter == it->second.end()) {
-                return DBStatus::notFound("Empty Content").toString();
+                return Reply::nil().withText(DBStatus::notFound("Empty Content").toString());
             } else {
-                return iter->second;
+                return Reply::bulk(iter->second);
             }
         }
     }
 
-    std::string DBServer::hgetAllCommand(VctS &&argv) {
-        if (argv.size() != 2) {
-            return DBStatus::IOError("Parameter error").toString();
+    Reply DBServer::hgetAllCommand(ClientState*, const CommandArgs& argv) {
+        const std::string key(argv[1]);
+        if (database_[dbIndex]->judgeKeyExpiredTime(kvDB::dbHash, key)) {
+            database_[dbIndex]->delKey(kvDB::dbHash, key);
+            return Reply::map({}).withText(kKeyExpired);
         }
-        std::string res = database_[dbIndex]->getKey(kvDB::dbHash, argv[1]);
-
-        return res.empty() ? DBStatus::IOError("Empty Content").toString() : res;
-    }
-
-    std::string DBServer::saddCommand(VctS &&argv) {
-        if (argv.size() != 3) {
-            return DBStatus::IOError("Parameter error").toString();
+        auto& hashes = database_[dbIndex]->getKeyHashObj();
+        auto it = hashes.find(key);
+        if (it == hashes.end()) {
+            return Reply::map({}).withText(DBStatus::notFound("key").toString());
+        }
+        if (it->second.empty()) {
+            return Reply::map({}).withText(DBStatus::IOError("Empty Content").toString());
         }
-        bool flag = database_[dbIndex]->addKey(kvDB::dbSet, argv[1], argv[2], kvDB::defaultObjValue);
+        std::vector<Reply> elements;
+        elements.reserve(it->second.size() * 2);
+        for (const auto& field : it->second) {
+            elements.push_back(Reply::bulk(field.first));
+            elements.push_back(Reply::bulk(field.second));
+        }
+        return Reply::map(std::move(elements), Reply::kPairs);
+    }
 
-        return flag ? DBStatus::Ok().toString() : DBStatus::IOError("sadd error").toString();
+    Reply DBServer::saddCommand(ClientState*, const CommandArgs& argv) {
+        const std::string key(argv[1]);
+        std::string member(argv[2]);
+        // RESP中返回新增的成员数
+        auto& sets = database_[dbIndex]->getKeySetObj();
+        auto it = sets.find(key);
+        bool added = it == sets.end() || it->second.find(member) == it->second.end();
+        bool flag = database_[dbIndex]->addKey(kvDB::dbSet, key, std::move(member), kvDB::defaultObjValue);
+
+        return flag ? Reply::integer(added ? 1 : 0).withText(DBStatus::Ok().toString()) :
+               Reply::error(DBStatus::IOError("sadd error"));
     }
 
-    std::string DBServer::smembersCommand(VctS &&argv) {
-        if (argv.size() != 2) {
-            return DBStatus::IOError("Parameter error").toString();
+    Reply DBServer::smembersCommand(ClientState*, const CommandArgs& argv) {
+        const std::string key(argv[1]);
+        if (database_[dbIndex]->judgeKeyExpiredTime(kvDB::dbSet, key)) {
+            database_[dbIndex]->delKey(kvDB::dbSet, key);
+            return Reply::set({}).withText(kKeyExpired);
         }
-        std::string res = database_[dbIndex]->getKey(kvDB::dbSet,argv[1]);
-
-        return res.empty() ? DBStatus::notFound("Empty Content").toString() : res;
+        auto& sets = database_[dbIndex]->getKeySetObj();
+        auto it = sets.find(key);
+        if (it == sets.end()) {
+            return Reply::set({}).withText(DBStatus::notFound("key").toString());
+        }
+        if (it->second.empty()) {
+            return Reply::set({}).withText(DBStatus::notFound("Empty Content").toString());
+        }
+        std::vector<Reply> members;
+        members.reserve(it->second.size());
+        for (const auto& member : it->second) {
+            members.push_back(Reply::bulk(member));
+        }
+        return Reply::set(std::move(members), Reply::kWords);
     }
 
-    std::string DBServer::zaddCommand(VctS &&argv) {
-        if(argv.size() != 4){
-            return DBStatus::IOError("Parameter error").toString();
+    Reply DBServer::zaddCommand(ClientState*, const CommandArgs& argv) {
+        /* 范围查询的边界是±DBL_MAX，inf的成员查不出来，和nan一样不接受 */
+        double score = 0;
+        if (!parseDouble(argv[3], &score) || !std::isfinite(score)) {
+            return Reply::error(DBStatus::IOError("score is not a valid float"));
         }
-        bool flag = database_[dbIndex]->addKey(kvDB::dbZSet,argv[1],argv[2],argv[3]);
+        bool flag = database_[dbIndex]->addKey(kvDB::dbZSet, std::string(argv[1]), std::string(argv[2]),
+                                               std::string(argv[3]));
 
-        return flag ? DBStatus::Ok().toString() : DBStatus::IOError("zadd error").toString();
+        return flag ? Reply::integer(1).withText(DBStatus::Ok().toString()) :
+               Reply::error(DBStatus::IOError("zadd error"));
     }
 
-    std::string DBServer::zcardCommand(VctS &&argv) {
-        if(argv.size() != 2){
-            return DBStatus::IOError("Parameter error").toString();
-        }
-        auto tmpZset = database_[dbIndex]->getKeyZSetObj();
-        auto it = tmpZset.find(argv[1]);
+    Reply DBServer::zcardCommand(ClientState*, const CommandArgs& argv) {
+        auto& tmpZset = database_[dbIndex]->getKeyZSetObj();
+        auto it = tmpZset.find(std::string(argv[1]));
         if(it == tmpZset.end()){
-            return DBStatus::notFound("key").toString();
+            return Reply::integer(0).withText(DBStatus::notFound("key").toString());
         }else{
-            return std::to_string(it->second->getLength());
+            return Reply::integer(static_cast<int64_t>(it->second->getLength()));
         }
     }
 
-    std::string DBServer::zrangeCommand(VctS &&argv) {
-        if(argv.size() != 4 || argv[2].empty() || argv[3].empty()){
-            return DBStatus::IOError("Parameter error").toString();
+    Reply DBServer::zrangeCommand(ClientState*, const CommandArgs& argv) {
+        double low, high;
+        if(!parseDouble(argv[2], &low) || !parseDouble(argv[3], &high)){
+            return Reply::error(DBStatus::IOError("Parameter error"));
         }
-        std::string res;
-        // zset的key
-        std::string args = argv[1];
-        // 添加range的范围
-        args += ':' + argv[2] + '@' + argv[3];
-        res = database_[dbIndex]->getKey(kvDB::dbZSet,args);
-
-        return res.empty() ? DBStatus::notFound("Empty Content").toString() : res;
+        return zsetRange(std::string(argv[1]), low, high);
     }
 
-    std::string DBServer::zcountCommand(VctS &&argv) {
-        if(argv.size() != 4 || argv[2].empty() || argv[3].empty()){
-            return DBStatus::IOError("Parameter error").toString();
+    Reply DBServer::zcountCommand(ClientState*, const CommandArgs& argv) {
+        double low, high;
+        if(!parseDouble(argv[2], &low) || !parseDouble(argv[3], &high)){
+            return Reply::error(DBStatus::IOError("Parameter error"));
         }
-        std::string res;
-        auto it = database_[dbIndex]->getKeyZSetObj();
-        RangeSpec range(std::stod(argv[2]),std::stod(argv[3]));
-        auto obj = it.find(argv[1]);
+        auto& it = database_[dbIndex]->getKeyZSetObj();
+        RangeSpec range(low, high);
+        auto obj = it.find(std::string(argv[1]));
         if(obj == it.end()){
-            res = DBStatus::notFound("key").toString();
-        }else{
-            res = "(count)" + std::to_string(obj->second->getCountInRange(range));
+            return Reply::integer(0).withText(DBStatus::notFound("key").toString());
         }
-        return res;
+        unsigned long count = obj->second->getCountInRange(range);
+        return Reply::integer(static_cast<int64_t>(count)).withText("(count)" + std::to_string(count));
     }
 
-    std::string DBServer::zgetAllCommand(VctS &&argv) {
-        if(argv.size() != 2){
-            return DBStatus::IOError("Parameter error").toString();
-        }
-        std::string res = database_[dbIndex]->getKey(kvDB::dbZSet,argv[1]);
+    Reply DBServer::zgetAllCommand(ClientState*, const CommandArgs& argv) {
+        return zsetRange(std::string(argv[1]), -DBL_MAX, DBL_MAX);
+    }
 
-        return res.empty() ? DBStatus::notFound("Empty Content").toString() : res;
+    Reply DBServer::zsetRange(const std::string& key, double low, double high) {
+        if (database_[dbIndex]->judgeKeyExpiredTime(kvDB::dbZSet, key)) {
+            database_[dbIndex]->delKey(kvDB::dbZSet, key);
+            return Reply::map({}).withText(kKeyExpired);
+        }
+        auto& zsets = database_[dbIndex]->getKeyZSetObj();
+        auto it = zsets.find(key);
+        if (it == zsets.end()) {
+            return Reply::map({}).withText(DBStatus::notFound("key").toString());
+        }
+        RangeSpec range(low, high);
+        std::vector<SkipListNode*> nodes(it->second->getNodeInRange(range));
+        if (nodes.empty()) {
+            return Reply::map({}).withText(DBStatus::notFound("Empty Content").toString());
+        }
+        // 成员 --> 分值
+        std::vector<Reply> elements;
+        elements.reserve(nodes.size() * 2);
+        for (SkipListNode* node : nodes) {
+            elements.push_back(Reply::bulk(node->obj_));
+            elements.push_back(Reply::bulk(scoreToString(node->score_)));
+        }
+        return Reply::map(std::move(elements), Reply::kLines);
     }
-    std::string DBServer::saveHead() {
-        std::string tmp = "KV0001";
-        return tmp;
+
+    void DBServer::saveHead(std::string* out) {
+        out->append("KV0002");
     }
 
-    std::string DBServer::saveSelectDB(const int index) {
-        return "SD" + std::to_string(index);
+    void DBServer::saveSelectDB(std::string* out, const int index) {
+        out->append("SD" + std::to_string(index) + "\n");
     }
 
-    std::string DBServer::saveExpiredTime(const Timestamp expiredTime) {
-        return "ST" + std::to_string(expiredTime.microSecondsSinceEpoch());
+    void DBServer::saveExpiredTime(std::string* out, const Timestamp expiredTime) {
+        out->append("ST" + std::to_string(expiredTime.microSecondsSinceEpoch()) + "\n");
     }
 
-    std::string DBServer::saveType(const int type) {
-        return "^" + std::to_string(type);
+    void DBServer::saveType(std::string* out, const int type) {
+        out->append("^" + std::to_string(type) + "\n");
     }
 
-    std::string DBServer::saveKV(const std::string &key, const std::string &value) {
-        char buf[1024];
-        sprintf(buf, "!%d#%s!%d$%s", static_cast<int>(key.size()),
-                key.c_str(),
-                static_cast<int>(value.size()),
-                value.c_str());
-        return std::string(buf);
+    void DBServer::saveCount(std::string* out, size_t count) {
+        out->append("*" + std::to_string(count) + "\n");
+    }
+
+    void DBServer::saveString(std::string* out, std::string_view str) {
+        out->append("$" + std::to_string(str.size()) + "\n");
+        out->append(str.data(), str.size());
     }
 
     bool DBServer::checkSaveCondition() {
+        if (childPid_ > 0) {
+            LOG_INFO("Background save already in progress\n");
+            return false;
+        }
         Timestamp save_interval = Timestamp::now() - lastSave_;
         if (save_interval > kvDB::rdbDefaultTime) {
             LOG_INFO("bgsaving...");
@@ -14,31 +14,78 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <atomic>
+#include <sys/types.h>
 #include "./net/EventLoop.h"
 #include "./net/InetAddress.h"
 #include "./net/TcpConnection.h"
 #include "./net/Buffer.h"
 #include "./net/Server.h"
 #include "./db/DataBase.h"
+#include "./comm/Config.h"
+#include "Reply.h"
+#include "RespParser.h"
+#include "CommandArgs.h"
 
 namespace kvDB {
     class DBServer {
     public:
-        typedef std::vector<std::string> VctS;
-
         /* 设置服务的连接回调，消息到达回调，初始化数据库 */
         DBServer(EventLoop* loop, const InetAddress& localAddr);
 
         ~DBServer() = default;
 
+        /* 连接建立时在连接上保存ClientState */
         void onConnection(const TcpConnectionPtr&);
 
-        /* 当消息到来时，执行的回调，取出应用层缓存中的消息，解析命令返回结果 */
+        /* 当消息到来时，执行的回调，取出应用层缓存中的消息，解析命令返回结果.
+         * buf中所有完整的命令都会执行(受event-*-budget限制)，不完整的命令留到下次读到数据后继续.
+         * 以'*'开头的数据按RESP多条批量请求解析，回复按连接的协议版本编码;
+         * 其他数据按旧的文本协议处理，一行(\n或\r\n结尾)是一条命令，回复是原来的字符串加上\r\n */
         void onMessage(const TcpConnectionPtr&,
                        Buffer* buf,
                        Timestamp);
 
-        /* 启动网络服务 */
+        /* 按配置文件设置服务的参数，必须在start()之前调用
+         * io-threads   : subLoop线程数，0表示所有连接都在baseLoop中处理
+         * threaded-io  : subLoop只负责读socket、切分命令和写回复，命令统一在baseLoop中串行执行，
+         *                数据库不需要加锁，适合回复大、瓶颈在系统调用和拷贝的负载；io-threads为0时无效(默认no)
+         * loop-balance : 新连接分配到subLoop的策略，round-robin、least-connections 或 incoming-cpu
+         *                (交给绑定在处理该连接RX队列的CPU上的subLoop，需要配合io-threads-cpulist和网卡队列的中断绑定)
+         * io-threads-cpulist: subLoop线程绑定的CPU，如 0-3,8-11，第i个线程绑定第i个CPU，
+         *                线程在本地NUMA节点上分配连接的缓冲区，不设置时不绑定(默认)
+         * epoll-et     : 监听fd和连接是否使用边沿触发(yes/no)
+         * save-interval: 定时检查并进行RDB持久化的间隔(秒)，0表示只在收到bgsave时持久化
+         * output-high-watermark / output-low-watermark:
+         *                连接待发送的回复超过高水位时暂停读取该连接的命令，回落到低水位后恢复(默认1mb/256kb)，
+         *                低水位必须小于高水位，否则改为高水位的1/4
+         * client-output-limit: 连接待发送的回复的硬上限，超过时断开连接，0表示不限制(默认)
+         * timeout      : 客户端空闲超过这个时间(秒)后关闭连接，0表示不关闭(默认)
+         * zerocopy-threshold: 不小于这个大小的get回复用MSG_ZEROCOPY发送，0表示不使用(默认)，如 64kb
+         * unixsocket   : 同时在这个路径上监听Unix域套接字，本机客户端不经过TCP协议栈，不设置时不监听(默认)
+         * unixsocketperm: Unix域套接字文件的权限(八进制)，如 700，0表示不修改(默认)
+         * accept-budget: 监听fd每次可读时最多accept的连接数(默认64)
+         * tcp-backlog  : listen的backlog(默认1024)
+         * tcp-defer-accept: 连接发来第一个命令之后才accept，超过这个秒数仍然accept，0表示不开启(默认)
+         * stats-interval: 每隔这个秒数在日志中输出accept和poll统计，0表示不输出(默认)
+         * coalesce-replies: 一轮事件中的回复在进入epoll_wait之前合并发送，pipeline时减少系统调用(默认yes)
+         * busy-poll    : io线程在有事件之后的这个微秒数内忙轮询，不睡眠，降低唤醒延迟，0表示关闭(默认)
+         * socket-busy-poll: 给连接设置SO_BUSY_POLL的微秒数，需要CAP_NET_ADMIN，0表示不设置(默认)
+         * event-command-budget / event-byte-budget:
+         *                一个连接每次读事件最多执行的命令数和处理的字节数，剩下的在本轮其他连接之后继续(默认256/1mb)
+         * loop-lag-threshold: 过载的阈值(毫秒)，loop从poll返回到处理完事件的时间超过阈值时暂停accept新连接，
+         *                写命令直接返回 "Busy: ..." 让客户端重试，已经读到的读命令照常执行，0表示不检查(默认)
+         * logfile      : 日志追加写到这个文件，不设置时写到标准输出(默认)
+         * 收到SIGHUP时重新打开logfile并重新读取配置文件，其中logfile、output-*、client-output-limit、
+         * zerocopy-threshold、event-*-budget、loop-lag-threshold、save-interval、stats-interval在运行中生效(水位和上限只对新连接生效)，
+         * 其他参数需要重启 */
+        void configure(const Config& config);
+
+        /* 注册SIGCHLD/SIGTERM/SIGINT/SIGHUP的处理，启动网络服务和定时任务 */
         void start();
 
         /*进行rdb持久化*/
@@ -47,67 +94,224 @@ namespace kvDB {
     private:
         // 数据分库的数目
         static const long DEFAULT_DB_NUM = 16;
-
-        /* 初始化数据库，绑定数据库命令 */
+        // 旧协议一行命令的最大长度，超过时还没有读到行尾则关闭连接
+        static const size_t kMaxInlineLen = 64 * 1024;
+
+        /* 保存在TcpConnection上下文中的连接状态 */
+        struct ClientState {
+            ClientState() : protover(2), protocolError(false) {}
+
+            RespParser parser;   // 只在连接所属的subLoop中使用
+            int protover;        // RESP回复的版本，HELLO修改，只在执行命令的线程中使用
+            bool protocolError;  // 已经回复了协议错误，之后读到的数据都丢弃，只在subLoop中使用
+        };
+
+        /* threaded-io模式下subLoop切分出的一批命令. 参数先指向连接的Buffer，
+         * 切分完之后takeInput把数据交给batch，在baseLoop中执行时参数指向input */
+        struct Batch {
+            struct Command {
+                bool resp;
+                size_t firstArg;   // 第一个参数在args中的下标
+                size_t argc;
+            };
+
+            /* 记录一条命令，frame是命令在连接的Buffer中的起始位置，takeInput之前Buffer中的数据不能被覆盖 */
+            void add(bool resp, const CommandArgs& argv, const char* frame) {
+                if (base == nullptr) {
+                    base = frame;
+                }
+                commands.push_back(Command{resp, args.size(), argv.size()});
+                for (const std::string_view& arg : argv) {
+                    args.emplace_back(static_cast<size_t>(arg.data() - base), arg.size());
+                }
+            }
+
+            /* 取走buf中已经切分的数据(base到buf->peek())，剩下的数据留在buf中 */
+            void takeInput(Buffer* buf);
+
+            std::shared_ptr<Buffer> input;   // 命令的数据，回复发送之后在subLoop中释放
+            const char* base = nullptr;      // 第一条命令的起始位置
+            std::vector<std::pair<size_t, size_t>> args;   // 参数相对于base的偏移和长度
+            std::vector<Command> commands;
+            std::string protocolError;       // 非空时在所有命令的回复之后回复这个协议错误，然后关闭连接
+            bool protocolErrorResp = false;  // 协议错误按RESP还是旧协议回复
+        };
+
+        /* 执行完的命令的回复，protover为0表示按旧协议发送 */
+        struct Output {
+            Reply reply;
+            int protover;
+        };
+
+        /* 命令的属性 */
+        enum CommandFlag {
+            kCmdWrite    = 1,   // 修改数据或者fork的命令，过载时拒绝
+            kCmdReadOnly = 2,   // 只读取数据(可能顺便删除过期的key)
+            kCmdRespOnly = 4,   // 只在RESP请求中有效
+        };
+
+        /* 命令表中的一条命令，命令表在编译期生成，按commandHash()无冲突地放进kCommandSlots个槽中 */
+        struct Command {
+            typedef Reply (DBServer::*Handler)(ClientState* client, const CommandArgs& argv);
+
+            /* argc(包括命令名)是否符合arity */
+            constexpr bool checkArity(size_t argc) const {
+                return arity >= 0 ? argc == static_cast<size_t>(arity) : argc >= static_cast<size_t>(-arity);
+            }
+
+            std::string_view name;   // 小写的命令名
+            int arity;               // 参数个数(包括命令名)，负数-N表示至少N个
+            int flags;               // CommandFlag的组合
+            int firstKey;            // 第一个key的下标，0表示没有key
+            int lastKey;             // 最后一个key的下标，负数表示从末尾往前数(-1是最后一个参数)
+            int keyStep;             // 相邻两个key的下标之差
+            Handler handler;
+        };
+
+        static constexpr size_t kCommandSlots = 32;
+
+        /* 不区分大小写的命令名hash，用长度、前两个字符和最后一个字符，系数使命令表中的命令没有冲突 */
+        static constexpr size_t commandHash(std::string_view name) {
+            const size_t second = name.size() > 1 ? static_cast<unsigned char>(name[1] | 0x20) : 0;
+            return (name.size() + 9 * static_cast<unsigned char>(name[0] | 0x20) + 2 * second +
+                    8 * static_cast<unsigned char>(name.back() | 0x20)) & (kCommandSlots - 1);
+        }
+
+        /* 在编译期把命令表按hash放进槽中，槽中保存命令在kCommands中的下标加1，0表示空槽 */
+        static constexpr std::array<uint8_t, kCommandSlots> buildCommandIndex();
+
+        static const Command kCommands[];
+        static const std::array<uint8_t, kCommandSlots> kCommandIndex;
+
+        /* 按命令名(不区分大小写)查找命令，一次hash和一次比较，没有这个命令时返回nullptr */
+        static const Command* lookupCommand(std::string_view name);
+
+        /* 初始化数据库 */
         void initDB();
 
-        /* 解析命令，将传入的参数保存到命令字典中对应命令的Vecs */
-        std::string parseMsg(const std::string& msg);
+        /* 执行命令的loop的延迟是否超过了loop-lag-threshold */
+        bool loopOverloaded(EventLoop* loop) const;
+
+        /* 过载时写命令的回复，可以重试的错误 */
+        Reply busyReply();
+
+        /* threaded-io模式下在baseLoop中执行一个连接一次读到的命令，回复交回连接所属的subLoop编码和发送 */
+        void executeBatch(const TcpConnectionPtr& conn, Batch& batch);
+
+        /* 执行一条命令，命令名不区分大小写. resp表示是RESP请求(kCmdRespOnly的命令只在RESP中有效)，
+         * 参数个数不符合arity时返回参数错误，overloaded时写命令直接返回busyReply() */
+        Reply execute(ClientState* client, const CommandArgs& argv, bool resp, bool overloaded);
+
+        /* HELLO [protover]: 切换连接的RESP版本(2或3)，返回服务器信息 */
+        Reply helloCommand(ClientState* client, const CommandArgs& argv);
+
+        Reply pingCommand(ClientState*, const CommandArgs& argv);
+
+        Reply setCommand(ClientState*, const CommandArgs& argv);
+
+        /* 直接返回数据库中的value，不拷贝 */
+        Reply getCommand(ClientState*, const CommandArgs& argv);
 
-        std::string setCommand(VctS &&);
+        Reply pExpiredCommand(ClientState*, const CommandArgs& argv);
 
-        std::string getCommand(VctS &&);
+        Reply expiredCommand(ClientState*, const CommandArgs& argv);
 
-        std::string pExpiredCommand(VctS &&);
+        Reply bgsaveCommand(ClientState*, const CommandArgs& argv);
 
-        std::string expiredCommand(VctS &&);
+        Reply selectCommand(ClientState*, const CommandArgs& argv);
 
-        std::string bgsaveCommand(VctS &&);
+        Reply rpushCommand(ClientState*, const CommandArgs& argv);
 
-        std::string selectCommand(VctS &&);
+        Reply rpopCommand(ClientState*, const CommandArgs& argv);
 
-        std::string rpushCommand(VctS &&);
+        Reply hsetCommand(ClientState*, const CommandArgs& argv);
 
-        std::string rpopCommand(VctS &&);
+        Reply hgetCommand(ClientState*, const CommandArgs& argv);
 
-        std::string hsetCommand(VctS &&);
+        Reply hgetAllCommand(ClientState*, const CommandArgs& argv);
 
-        std::string hgetCommand(VctS &&);
+        Reply saddCommand(ClientState*, const CommandArgs& argv);
 
-        std::string hgetAllCommand(VctS &&);
+        Reply smembersCommand(ClientState*, const CommandArgs& argv);
 
-        std::string saddCommand(VctS &&);
+        Reply zaddCommand(ClientState*, const CommandArgs& argv);
 
-        std::string smembersCommand(VctS &&);
+        Reply zcardCommand(ClientState*, const CommandArgs& argv);
 
-        std::string zaddCommand(VctS &&);
+        Reply zrangeCommand(ClientState*, const CommandArgs& argv);
 
-        std::string zcardCommand(VctS &&);
+        Reply zcountCommand(ClientState*, const CommandArgs& argv);
 
-        std::string zrangeCommand(VctS &&);
+        Reply zgetAllCommand(ClientState*, const CommandArgs& argv);
 
-        std::string zcountCommand(VctS &&);
+        /* 有序集合key中分值在[low, high]内的成员和分值 */
+        Reply zsetRange(const std::string& key, double low, double high);
 
-        std::string zgetAllCommand(VctS &&);
+        /* rdb文件(KV0002格式): KV0002 {SD<db>\n {^<type>\n {ST<过期时间>\n key 数据}}} EOF
+         * 字符串都写成 $<长度>\n<内容>，可以包含任意字节; 集合先写 *<元素个数>\n，
+         * Hash和ZSet的每个元素是两个字符串(field value / member score) */
+        static void saveHead(std::string* out);
 
-        std::string saveHead();
+        static void saveSelectDB(std::string* out, const int index);
 
-        std::string saveSelectDB(const int index);
+        static void saveExpiredTime(std::string* out, const Timestamp expiredTime);
 
-        std::string saveExpiredTime(const Timestamp expiredTime);
+        static void saveType(std::string* out, const int type);
 
-        std::string saveType(const int type);
+        static void saveCount(std::string* out, size_t count);
 
-        std::string saveKV(const std::string& key, const std::string& value);
+        static void saveString(std::string* out, std::string_view str);
 
         bool checkSaveCondition();
 
+        /* dump.rdb的路径(当前工作目录下) */
+        static std::string rdbFilePath();
+
+        /* 把所有数据库序列化写到path，bgsave的子进程和关闭服务时调用，调用者持有dbMutex_ */
+        bool rdbSaveToFile(const std::string& path);
+
+        /* 设置可以在运行中修改的参数，configure和SIGHUP时调用 */
+        void applyTunables(const Config& config);
+
+        /* 按saveInterval_和statsInterval_重新注册定时任务 */
+        void startTimers();
+
+        /* SIGCHLD: 回收子进程，在日志中报告bgsave的结果和耗时 */
+        void reapChildren();
+
+        /* SIGTERM/SIGINT: 杀掉正在进行的bgsave，开启了定时持久化时同步保存一次，然后退出loop */
+        void shutdown(int signo);
+
+        /* SIGHUP: 重新打开日志文件，重新读取配置文件 */
+        void reload();
+
+        /* 定时任务，在baseLoop中按saveInterval_执行 */
+        void serverCron();
+
+        /* 在日志中输出accept统计(每次唤醒平均accept的连接数、最大值、预算用完的次数)
+         * 和poll统计(忙轮询与阻塞poll的次数之比、忙轮询取到事件的比例) */
+        void logStats();
+
         // db相关
         std::vector<std::unique_ptr<Database>> database_; // 分库管理Database的容器
         int dbIndex;                                      // 数据库的index
-        /* 保存所有命令应该调用的接口  first-->cmd  second-->cmd对应的处理函数，Vcts保存parseMsg()解析的传入 */
-        std::unordered_map<std::string, std::function<std::string(VctS &&)>> cmdDict;
         Timestamp lastSave_;     // 最后一次进行RDB落盘
+        double saveInterval_;    // 定时RDB持久化的间隔(秒)
+        double statsInterval_;   // 输出统计的间隔(秒)
+        std::atomic<size_t> commandBudget_;   // 一个连接每次最多执行的命令数，SIGHUP时可能被baseLoop修改
+        std::atomic<size_t> byteBudget_;      // 一个连接每次最多处理的字节数
+        pid_t childPid_;         // 正在进行bgsave的子进程，-1表示没有
+        Timestamp childStart_;   // bgsave开始的时间
+        TimerId saveTimer_;
+        TimerId statsTimer_;
+        Config config_;          // configure时的配置，SIGHUP时重新读取
+        bool started_;
+        bool threadedIo_;        // 命令是否统一在baseLoop中执行
+        std::atomic<int64_t> lagThresholdUs_;    // 过载的loop延迟阈值(微秒)，0表示不检查
+        std::atomic<uint64_t> rejectedWrites_;   // 过载时拒绝的写命令数
+        /* 多个subLoop会并发执行命令，命令的执行(对database_, dbIndex, lastSave_, childPid_的访问)需要串行化.
+         * threaded-io模式下命令都在baseLoop中执行，执行命令时不加锁 */
+        std::mutex dbMutex_;
 
         // net相关
         EventLoop* loop_;
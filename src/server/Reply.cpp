@@ -0,0 +1,200 @@
+/**
+  ******************************************************************************
+  * @file           : Reply.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-29
+  ******************************************************************************
+  */
+
+
+#include "Reply.h"
+
+namespace kvDB {
+    Reply Reply::status(std::string str) {
+        Reply reply(kStatus);
+        reply.str_ = std::move(str);
+        return reply;
+    }
+
+    Reply Reply::error(DBStatus status) {
+        Reply reply(kError);
+        reply.str_ = status.toRespError();
+        reply.text_ = status.toString();
+        reply.hasText_ = true;
+        return reply;
+    }
+
+    Reply Reply::bulk(std::string str) {
+        Reply reply(kBulk);
+        reply.str_ = std::move(str);
+        return reply;
+    }
+
+    Reply Reply::bulk(std::shared_ptr<const std::string> value) {
+        Reply reply(kBulk);
+        reply.value_ = std::move(value);
+        return reply;
+    }
+
+    Reply Reply::nil() {
+        return Reply(kNil);
+    }
+
+    Reply Reply::integer(int64_t value) {
+        Reply reply(kInteger);
+        reply.integer_ = value;
+        return reply;
+    }
+
+    Reply Reply::array(std::vector<Reply> elements, TextStyle style) {
+        Reply reply(kArray);
+        reply.elements_ = std::move(elements);
+        reply.style_ = style;
+        return reply;
+    }
+
+    Reply Reply::set(std::vector<Reply> elements, TextStyle style) {
+        Reply reply(kSet);
+        reply.elements_ = std::move(elements);
+        reply.style_ = style;
+        return reply;
+    }
+
+    Reply Reply::map(std::vector<Reply> elements, TextStyle style) {
+        Reply reply(kMap);
+        reply.elements_ = std::move(elements);
+        reply.style_ = style;
+        return reply;
+    }
+
+    std::string Reply::text() const {
+        if (hasText_) {
+            return text_;
+        }
+        switch (type_) {
+            case kStatus:
+            case kError:
+                return str_;
+            case kBulk:
+                return value_ ? *value_ : str_;
+            case kNil:
+                return std::string();
+            case kInteger:
+                return std::to_string(integer_);
+            default: {
+                std::string out;
+                appendText(&out);
+                return out;
+            }
+        }
+    }
+
+    void Reply::appendText(std::string* out) const {
+        switch (style_) {
+            case kWords:
+                for (const Reply& element : elements_) {
+                    out->append(element.text());
+                    out->push_back(' ');
+                }
+                break;
+            case kPairs:
+                for (size_t i = 0; i + 1 < elements_.size(); i += 2) {
+                    out->append(elements_[i].text());
+                    out->push_back(':');
+                    out->append(elements_[i + 1].text());
+                    out->push_back(' ');
+                }
+                break;
+            case kLines:
+                for (size_t i = 0; i + 1 < elements_.size(); i += 2) {
+                    if (i > 0) {
+                        out->push_back('\n');
+                    }
+                    out->append(elements_[i].text());
+                    out->push_back(':');
+                    out->append(elements_[i + 1].text());
+                }
+                break;
+        }
+    }
+
+    Slice Reply::toSlice() && {
+        if (hasText_) {
+            return Slice(std::move(text_));
+        }
+        if (type_ == kBulk && value_) {
+            return Slice(std::move(value_));
+        }
+        if (type_ == kStatus || type_ == kBulk) {
+            return Slice(std::move(str_));
+        }
+        return Slice(text());
+    }
+
+    void Reply::appendResp(OutputChain* out, int protover) && {
+        std::string pending;
+        std::move(*this).encodeResp(out, &pending, protover);
+        out->append(std::move(pending));
+    }
+
+    void Reply::appendHeader(std::string* out, char prefix, int64_t len) {
+        out->push_back(prefix);
+        out->append(std::to_string(len));
+        out->append("\r\n", 2);
+    }
+
+    void Reply::encodeResp(OutputChain* out, std::string* pending, int protover) && {
+        switch (type_) {
+            case kStatus:
+                pending->push_back('+');
+                pending->append(str_);
+                pending->append("\r\n", 2);
+                break;
+            case kError:
+                pending->push_back('-');
+                pending->append(str_);
+                pending->append("\r\n", 2);
+                break;
+            case kBulk: {
+                const std::string& data = value_ ? *value_ : str_;
+                appendHeader(pending, '$', static_cast<int64_t>(data.size()));
+                if (value_ && data.size() >= OutputChain::kCoalesceSize) {
+                    /* 大的value单独作为共享数据片，不拷贝 */
+                    out->append(std::move(*pending));
+                    pending->clear();
+                    out->append(std::move(value_));
+                } else {
+                    pending->append(data);
+                }
+                pending->append("\r\n", 2);
+                break;
+            }
+            case kNil:
+                pending->append(protover >= 3 ? "_\r\n" : "$-1\r\n");
+                break;
+            case kInteger:
+                pending->push_back(':');
+                pending->append(std::to_string(integer_));
+                pending->append("\r\n", 2);
+                break;
+            case kArray:
+            case kSet:
+            case kMap: {
+                const auto len = static_cast<int64_t>(elements_.size());
+                if (protover >= 3 && type_ == kMap) {
+                    appendHeader(pending, '%', len / 2);
+                } else if (protover >= 3 && type_ == kSet) {
+                    appendHeader(pending, '~', len);
+                } else {
+                    appendHeader(pending, '*', len);
+                }
+                for (Reply& element : elements_) {
+                    std::move(element).encodeResp(out, pending, protover);
+                }
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,98 @@
+/**
+  ******************************************************************************
+  * @file           : Reply.h
+  * @author         : zgys
+  * @brief          : 命令处理函数的返回值，带类型的回复(状态、错误、批量字符串、空值、整数、数组、集合、映射)
+  * @attention      : 同一个回复可以按旧的文本协议输出，也可以按RESP2/RESP3编码;
+  *                   旧协议的文本默认由类型和内容生成，和原来不一致的地方用withText覆盖
+  * @date           : 23-4-20
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_REPLY_H
+#define KVDB_REPLY_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "./net/OutputChain.h"
+#include "./db/DBStatus.h"
+
+namespace kvDB {
+    class Reply {
+    public:
+        enum Type {
+            kStatus,   // 简单字符串，如 OK
+            kError,    // 错误
+            kBulk,     // 批量字符串，二进制安全
+            kNil,      // 空值，如key不存在
+            kInteger,  // 整数
+            kArray,    // 数组
+            kSet,      // 集合，RESP2中按数组编码
+            kMap,      // 映射，元素按 k1 v1 k2 v2 排列，RESP2中按数组编码
+        };
+
+        /* 聚合类型在旧协议中的文本格式 */
+        enum TextStyle {
+            kWords,    // "m1 m2 "
+            kPairs,    // "k1:v1 k2:v2 "
+            kLines,    // "k1:v1\nk2:v2"
+        };
+
+        Reply() : type_(kNil), integer_(0), style_(kWords), hasText_(false) {}
+
+        static Reply status(std::string str);
+        /* 旧协议输出status.toString()，RESP输出status.toRespError() */
+        static Reply error(DBStatus status);
+        static Reply bulk(std::string str);
+        /* 引用共享的value，发送时不拷贝 */
+        static Reply bulk(std::shared_ptr<const std::string> value);
+        static Reply nil();
+        static Reply integer(int64_t value);
+        static Reply array(std::vector<Reply> elements, TextStyle style = kWords);
+        static Reply set(std::vector<Reply> elements, TextStyle style = kWords);
+        static Reply map(std::vector<Reply> elements, TextStyle style = kPairs);
+
+        /* 旧协议中用text代替按类型生成的文本 */
+        Reply withText(std::string text) && {
+            text_ = std::move(text);
+            hasText_ = true;
+            return std::move(*this);
+        }
+
+        Type type() const { return type_; }
+        bool isError() const { return type_ == kError; }
+
+        /* 旧协议的文本 */
+        std::string text() const;
+
+        /* 转换为旧协议的发送数据片，转换后Reply为空 */
+        Slice toSlice() &&;
+
+        /* 按RESP编码追加到out，protover为2或3，大的共享value作为单独的数据片不拷贝 */
+        void appendResp(OutputChain* out, int protover) &&;
+
+    private:
+        explicit Reply(Type type) : type_(type), integer_(0), style_(kWords), hasText_(false) {}
+
+        /* 聚合类型的旧协议文本 */
+        void appendText(std::string* out) const;
+        /* 小的数据先拼接在pending中，遇到大的共享value时把pending和value依次追加到out */
+        void encodeResp(OutputChain* out, std::string* pending, int protover) &&;
+        /* 把RESP的类型头(如 *3\r\n)追加到out */
+        static void appendHeader(std::string* out, char prefix, int64_t len);
+
+        Type type_;
+        std::string str_;                          // status/bulk的内容，error的RESP文本
+        std::shared_ptr<const std::string> value_; // 共享的bulk
+        int64_t integer_;
+        std::vector<Reply> elements_;              // 聚合类型的元素
+        TextStyle style_;
+        std::string text_;                         // 覆盖的旧协议文本
+        bool hasText_;
+    };
+}
+
+#endif //KVDB_REPLY_H
@@ -0,0 +1,113 @@
+/**
+  ******************************************************************************
+  * @file           : RespParser.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-29
+  ******************************************************************************
+  */
+
+
+#include "RespParser.h"
+
+namespace kvDB {
+    RespParser::Result RespParser::fail(const std::string& error) {
+        error_ = error;
+        pos_ = 0;
+        multibulkLen_ = 0;
+        bulkLen_ = -1;
+        args_.clear();
+        return kError;
+    }
+
+    RespParser::Result RespParser::readLength(const Buffer* buf, char prefix, long long max, long long* len) {
+        const char* start = buf->peek() + pos_;
+        const char* crlf = buf->findCRLF(start);
+        if (crlf == nullptr) {
+            if (buf->readableBytes() - pos_ > kMaxLineLen) {
+                return fail("too big length line");
+            }
+            return kIncomplete;
+        }
+        const char* p = start;
+        if (*p != prefix) {
+            return fail(std::string("expected '") + prefix + "', got '" + *p + "'");
+        }
+        ++p;
+        /* 只接受十进制整数，*-1 和 *0 都当作空请求 */
+        long long value = 0;
+        bool negative = false;
+        if (p < crlf && *p == '-') {
+            negative = true;
+            ++p;
+        }
+        if (p == crlf) {
+            return fail("invalid length");
+        }
+        for (; p < crlf; ++p) {
+            if (*p < '0' || *p > '9' || value > max) {
+                return fail("invalid length");
+            }
+            value = value * 10 + (*p - '0');
+        }
+        if (value > max) {
+            return fail(prefix == '*' ? "invalid multibulk length" : "invalid bulk length");
+        }
+        *len = negative ? -value : value;
+        pos_ = crlf + 2 - buf->peek();
+        return kComplete;
+    }
+
+    RespParser::Result RespParser::parse(const Buffer* buf, CommandArgs* args, size_t* frameLen) {
+        if (multibulkLen_ == 0) {
+            long long len = 0;
+            Result res = readLength(buf, '*', kMaxMultibulkLen, &len);
+            if (res != kComplete) {
+                return res;
+            }
+            args_.clear();
+            if (len <= 0) {
+                /* 空请求，返回空的args由调用者跳过 */
+                args->clear();
+                *frameLen = pos_;
+                pos_ = 0;
+                return kComplete;
+            }
+            multibulkLen_ = len;
+        }
+        while (multibulkLen_ > 0) {
+            if (bulkLen_ < 0) {
+                long long len = 0;
+                Result res = readLength(buf, '$', kMaxBulkLen, &len);
+                if (res != kComplete) {
+                    return res;
+                }
+                if (len < 0) {
+                    return fail("invalid bulk length");
+                }
+                bulkLen_ = len;
+            }
+            /* 参数和结尾的\r\n都到齐之后才算读完，大参数只比较长度，不扫描内容 */
+            const auto need = static_cast<size_t>(bulkLen_) + 2;
+            if (buf->readableBytes() - pos_ < need) {
+                return kIncomplete;
+            }
+            const char* data = buf->peek() + pos_;
+            if (data[bulkLen_] != '\r' || data[bulkLen_ + 1] != '\n') {
+                return fail("bulk not terminated by CRLF");
+            }
+            args_.emplace_back(pos_, static_cast<size_t>(bulkLen_));
+            pos_ += need;
+            bulkLen_ = -1;
+            --multibulkLen_;
+        }
+        args->clear();
+        for (const auto& arg : args_) {
+            args->push_back(std::string_view(buf->peek() + arg.first, arg.second));
+        }
+        *frameLen = pos_;
+        pos_ = 0;
+        return kComplete;
+    }
+}
@@ -0,0 +1,64 @@
+/**
+  ******************************************************************************
+  * @file           : RespParser.h
+  * @author         : zgys
+  * @brief          : RESP多条批量请求(*N\r\n$len\r\narg\r\n...)的增量解析器
+  * @attention      : 每个连接一个解析器，一条请求可以分多次读到. 请求完整之前不从Buffer中取走数据，
+  *                   解析器记录已经解析完的参数在Buffer中的位置，下次读到数据时从上次停下的地方继续，不重新扫描
+  * @date           : 23-4-29
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_RESPPARSER_H
+#define KVDB_RESPPARSER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "./net/Buffer.h"
+#include "CommandArgs.h"
+
+namespace kvDB {
+    class RespParser {
+    public:
+        enum Result {
+            kComplete,    // 解析出一条完整的请求
+            kIncomplete,  // 数据不完整，等待下次读到数据后继续
+            kError,       // 格式错误，连接应该关闭
+        };
+
+        static const long long kMaxMultibulkLen = 1024 * 1024;        // 一条请求最多的参数个数
+        static const long long kMaxBulkLen = 512LL * 1024 * 1024;     // 一个参数的最大长度
+        static const size_t kMaxLineLen = 64 * 1024;                   // *N 和 $len 行的最大长度
+
+        RespParser() : pos_(0), multibulkLen_(0), bulkLen_(-1) {}
+
+        /* buf中的数据是否是RESP请求: 正在解析一条请求，或者以'*'开头 */
+        bool accept(const Buffer* buf) const {
+            return multibulkLen_ > 0 || (buf->readableBytes() > 0 && *buf->peek() == '*');
+        }
+
+        /* 从buf中解析一条请求，完整时args指向buf中的参数，frameLen是请求的长度，返回kComplete，
+         * 调用者用完args之后从buf中取走frameLen字节; 不完整时返回kIncomplete，buf中的数据保持不变，
+         * 下次读到数据后再调用; 格式错误时返回kError */
+        Result parse(const Buffer* buf, CommandArgs* args, size_t* frameLen);
+
+        /* 最近一次kError的原因 */
+        const std::string& error() const { return error_; }
+
+    private:
+        /* 读取pos_处以prefix开头的长度行(如 *3\r\n)，行不完整时返回kIncomplete */
+        Result readLength(const Buffer* buf, char prefix, long long max, long long* len);
+
+        Result fail(const std::string& error);
+
+        size_t pos_;                      // 当前请求已经解析的字节数(相对于buf->peek())
+        long long multibulkLen_;          // 当前请求还没有读到的参数个数，0表示在两条请求之间
+        long long bulkLen_;               // 当前参数的长度，-1表示还没有读到 $len 行
+        std::vector<std::pair<size_t, size_t>> args_;   // 已经读到的参数相对于buf->peek()的偏移和长度
+        std::string error_;
+    };
+}
+
+#endif //KVDB_RESPPARSER_H
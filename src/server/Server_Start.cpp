@@ -10,15 +10,48 @@
 
 
 #include "DBServer.h"
+#include "./net/Poller.h"
+#include "./comm/Affinity.h"
+#include "./comm/Logger.h"
+
+namespace kvDB {
+    /* 把主线程绑定到server-cpulist，主线程之后分配的内存在本地NUMA节点上 */
+    static void bindServerCpus(const std::string& cpuList) {
+        if (cpuList.empty()) {
+            return;
+        }
+        std::vector<int> cpus;
+        if (!parseCpuList(cpuList, &cpus) || !bindThreadToCpus(cpus)) {
+            LOG_ERROR("bind main thread to server-cpulist %s failed\n", cpuList.c_str());
+            return;
+        }
+        useLocalNumaMemory();
+        LOG_INFO("main thread bound to cpu %s (numa node %d)\n", cpuList.c_str(), numaNodeOfCpu(cpus[0]));
+    }
+}
+
+/* 用法: Server_Start [配置文件路径], 默认读取当前目录下的kvdb.conf
+ * io-backend 必须在创建EventLoop之前读取: epoll(默认) | io_uring
+ * server-cpulist 必须在创建EventLoop和加载数据库之前设置: 主线程(baseLoop)绑定的CPU，如 0-1，
+ *                数据库在主线程的NUMA节点上分配；之后创建的线程继承这个CPU集合，除非设置了io-threads-cpulist */
+int main(int argc, char* argv[]) {
+    kvDB::Config config;
+    config.load(argc > 1 ? argv[1] : "kvdb.conf");
+
+    if (config.getString("io-backend", "epoll") == "io_uring") {
+        kvDB::Poller::setDefaultBackend(kvDB::Poller::kIoUring);
+    }
+
+    kvDB::bindServerCpus(config.getString("server-cpulist", ""));
 
-int main() {
     kvDB::EventLoop loop;
-    kvDB::InetAddress localAddr(9981);
+    kvDB::InetAddress localAddr(static_cast<uint16_t>(config.getInt("port", 9981)));
     kvDB::DBServer dbServer(&loop,localAddr);
 
+    dbServer.configure(config);
     dbServer.start();
     loop.loop();
 
     return 0;
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,86 @@
+/**
+  ******************************************************************************
+  * @file           : Affinity.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-28
+  ******************************************************************************
+  */
+
+
+#include "Affinity.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+namespace kvDB {
+    bool parseCpuList(const std::string& list, std::vector<int>* cpus) {
+        cpus->clear();
+        std::istringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (item.empty()) {
+                continue;
+            }
+            char* end = nullptr;
+            long first = strtol(item.c_str(), &end, 10);
+            long last = first;
+            if (*end == '-') {
+                last = strtol(end + 1, &end, 10);
+            }
+            if (*end != '\0' || first < 0 || last < first || last >= CPU_SETSIZE) {
+                return false;
+            }
+            for (long cpu = first; cpu <= last; ++cpu) {
+                cpus->push_back(static_cast<int>(cpu));
+            }
+        }
+        return !cpus->empty();
+    }
+
+    bool bindThreadToCpus(const std::vector<int>& cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus) {
+            CPU_SET(cpu, &set);
+        }
+        /* pthread函数返回错误码而不设置errno，这里转成errno方便调用者输出 */
+        int err = ::pthread_setaffinity_np(::pthread_self(), sizeof set, &set);
+        if (err != 0) {
+            errno = err;
+            return false;
+        }
+        return true;
+    }
+
+    bool useLocalNumaMemory() {
+        /* 不依赖libnuma，直接调用set_mempolicy */
+        return ::syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) == 0;
+    }
+
+    int numaNodeOfCpu(int cpu) {
+        /* /sys/devices/system/cpu/cpuN/ 下有一个 nodeX 的链接 */
+        std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        DIR* dir = ::opendir(path.c_str());
+        if (dir == nullptr) {
+            return -1;
+        }
+        int node = -1;
+        while (struct dirent* entry = ::readdir(dir)) {
+            if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+                node = atoi(entry->d_name + 4);
+                break;
+            }
+        }
+        ::closedir(dir);
+        return node;
+    }
+}
@@ -0,0 +1,33 @@
+/**
+  ******************************************************************************
+  * @file           : Affinity.h
+  * @author         : zgys
+  * @brief          : 线程的CPU绑定和NUMA内存策略
+  * @attention      : 只作用于调用线程，之后创建的线程继承调用线程的CPU集合
+  * @date           : 23-4-28
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_AFFINITY_H
+#define KVDB_AFFINITY_H
+
+#include <string>
+#include <vector>
+
+namespace kvDB {
+    /* 解析CPU列表，格式同taskset -c，如 "0-3,8,10-11"，格式错误时返回false */
+    bool parseCpuList(const std::string& list, std::vector<int>* cpus);
+
+    /* 把当前线程绑定到cpus中的CPU上，成功返回true */
+    bool bindThreadToCpus(const std::vector<int>& cpus);
+
+    /* 当前线程之后分配的内存优先从运行所在CPU的NUMA节点上分配(MPOL_LOCAL)，
+     * 进程被numactl --interleave等启动时也按线程就近分配，成功返回true */
+    bool useLocalNumaMemory();
+
+    /* cpu所在的NUMA节点，没有NUMA信息时返回-1 */
+    int numaNodeOfCpu(int cpu);
+}
+
+#endif //KVDB_AFFINITY_H
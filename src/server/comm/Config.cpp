@@ -0,0 +1,77 @@
+/**
+  ******************************************************************************
+  * @file           : Config.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-8
+  ******************************************************************************
+  */
+
+
+#include "Config.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+
+namespace kvDB {
+
+    bool Config::load(const std::string& path) {
+        path_ = path;
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            return false;
+        }
+
+        items_.clear();
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream ss(line);
+            std::string key, value;
+            ss >> key;
+            if (key.empty() || key[0] == '#') {
+                continue;
+            }
+            ss >> value;
+            items_[key] = value;
+        }
+        return true;
+    }
+
+    std::string Config::getString(const std::string& key, const std::string& def) const {
+        auto it = items_.find(key);
+        return it == items_.end() ? def : it->second;
+    }
+
+    long Config::getInt(const std::string& key, long def) const {
+        auto it = items_.find(key);
+        if (it == items_.end() || it->second.empty()) {
+            return def;
+        }
+        return strtol(it->second.c_str(), nullptr, 10);
+    }
+
+    bool Config::getBool(const std::string& key, bool def) const {
+        auto it = items_.find(key);
+        if (it == items_.end()) {
+            return def;
+        }
+        return it->second == "yes" || it->second == "on" || it->second == "true" || it->second == "1";
+    }
+
+    size_t Config::getBytes(const std::string& key, size_t def) const {
+        auto it = items_.find(key);
+        if (it == items_.end() || it->second.empty()) {
+            return def;
+        }
+        char* unit = nullptr;
+        size_t bytes = strtoull(it->second.c_str(), &unit, 10);
+        switch (tolower(static_cast<unsigned char>(*unit))) {
+            case 'k': return bytes << 10;
+            case 'm': return bytes << 20;
+            case 'g': return bytes << 30;
+            default:  return bytes;
+        }
+    }
+}
@@ -0,0 +1,48 @@
+/**
+  ******************************************************************************
+  * @file           : Config.h
+  * @author         : zgys
+  * @brief          : 配置文件，每行一个配置项，格式为 "key value"，'#'开头的行为注释
+  * @attention      : None
+  * @date           : 23-4-8
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_CONFIG_H
+#define KVDB_CONFIG_H
+
+#include <string>
+#include <unordered_map>
+
+namespace kvDB {
+    class Config {
+    public:
+        Config() = default;
+        ~Config() = default;
+
+        /* 从path读取配置，文件不存在或无法打开时返回false */
+        bool load(const std::string& path);
+
+        /* 重新读取上一次load的配置文件 */
+        bool reload() { return load(path_); }
+
+        const std::string& path() const { return path_; }
+
+        /* 是否配置了key */
+        bool has(const std::string& key) const { return items_.find(key) != items_.end(); }
+
+        /* 获取配置项，未配置时返回默认值def */
+        std::string getString(const std::string& key, const std::string& def) const;
+        long getInt(const std::string& key, long def) const;
+        bool getBool(const std::string& key, bool def) const;
+        /* 字节数，可以带单位 k/kb/m/mb/g/gb(不区分大小写，按1024换算)，如 64mb */
+        size_t getBytes(const std::string& key, size_t def) const;
+
+    private:
+        std::string path_;                                   // 配置文件的路径
+        std::unordered_map<std::string, std::string> items_; // first-->key second-->value
+    };
+}
+
+#endif //KVDB_CONFIG_H
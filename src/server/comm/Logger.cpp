@@ -14,31 +14,56 @@
 
 namespace kvDB {
 
-    // 设置日志级别
-    void Logger::setLogLevel(int level) {
-        logLevel_ = level;
-    }
-
     // 写日志 [级别] time:msg
-    void Logger::log(const std::string& msg) const {
-        switch (logLevel_) {
+    void Logger::log(int level, const std::string& msg) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::ostream& out = file_ ? *file_ : std::cout;
+        switch (level) {
             case INFO:
-                std::cout<<"[INFO]";
+                out<<"[INFO]";
                 break;
             case DEBUG:
-                std::cout<<"[DEBUG]";
+                out<<"[DEBUG]";
+                break;
+            case WARN:
+                out<<"[WARN]";
                 break;
             case ERROR:
-                std::cout<<"[ERROR]";
+                out<<"[ERROR]";
                 break;
             case FATAL:
-                std::cout<<"[FATAL]";
+                out<<"[FATAL]";
                 break;
             default:
                 break;
         }
         // 输出time和msg
-        std::cout <<  Timestamp::now().toString() << " : " << msg << std::endl;
+        out <<  Timestamp::now().toString() << " : " << msg << std::endl;
+    }
+
+    bool Logger::setLogFile(const std::string& path) {
+        std::unique_ptr<std::ofstream> file;
+        if (!path.empty()) {
+            file.reset(new std::ofstream(path, std::ios::out | std::ios::app));
+            if (!file->is_open()) {
+                return false;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        path_ = path;
+        file_ = std::move(file);
+        return true;
+    }
+
+    void Logger::reopen() {
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            path = path_;
+        }
+        if (!path.empty()) {
+            setLogFile(path);
+        }
     }
 
 }
\ No newline at end of file
@@ -14,6 +14,8 @@
 
 #include <string>
 #include <memory>
+#include <mutex>
+#include <fstream>
 #include "Singleton.h"
 #include "Noncopyable.h"
 
@@ -23,10 +25,9 @@ namespace kvDB {
     do                                                                  \
     {                                                                   \
        Logger::ptr logger = kvDB::Singleton_Logger::GetInstance();      \
-       logger->setLogLevel(INFO);                                       \
        char buf[1024] = {0};                                            \
        snprintf(buf,1024,logmsg, ##__VA_ARGS__);                        \
-       logger->log(buf);                                                \
+       logger->log(INFO, buf);                                          \
     }while(0)
 
 #ifdef MUDEBUG
@@ -34,10 +35,9 @@ namespace kvDB {
     do                                                                 \
     {                                                                  \
        Logger::ptr logger = kvDB::Singleton_Logger::GetInstance();     \
-       logger->setLogLevel(DEBUG);                                      \
        char buf[1024] = {0};                                           \
        snprintf(buf,1024,logmsg, ##__VA_ARGS__);                       \
-       logger->log(buf);                                                \
+       logger->log(DEBUG, buf);                                        \
     }while(0)
 #else
 #define LOG_DEBUG(logmsg,...)
@@ -47,30 +47,27 @@ namespace kvDB {
     do                                                                \
     {                                                                 \
        Logger::ptr logger = kvDB::Singleton_Logger::GetInstance();    \
-       logger->setLogLevel(WARN);                                      \
        char buf[1024] = {0};                                          \
        snprintf(buf,1024,logmsg,##__VA_ARGS__);                       \
-       logger->log(buf);                                               \
+       logger->log(WARN, buf);                                        \
     }while(0)
 
 #define LOG_ERROR(logmsg,...)                                         \
     do                                                                \
     {                                                                 \
        Logger::ptr logger = kvDB::Singleton_Logger::GetInstance();    \
-       logger->setLogLevel(ERROR);                                     \
        char buf[1024] = {0};                                          \
        snprintf(buf,1024,logmsg,##__VA_ARGS__);                       \
-       logger->log(buf);                                               \
+       logger->log(ERROR, buf);                                       \
     }while(0)
 
 #define LOG_FATAL(logmsg,...)                                         \
     do                                                                \
     {                                                                 \
        Logger::ptr logger = kvDB::Singleton_Logger::GetInstance();    \
-       logger->setLogLevel(FATAL);                                     \
        char buf[1024] = {0};                                          \
        snprintf(buf,1024,logmsg,##__VA_ARGS__);                       \
-       logger->log(buf);                                               \
+       logger->log(FATAL, buf);                                       \
        exit(-1);                                                      \
     }while(0)
 
@@ -88,13 +85,18 @@ class Logger : public Noncopyable {
     public:
         typedef std::shared_ptr<Logger> ptr;
 
-        // 设置日志级别
-        void setLogLevel(int level);
-        // 写日志
-        void log(const std::string& msg) const;
+        // 写一条level级别的日志，级别作为参数传入，多个线程同时写日志时不会互相覆盖
+        void log(int level, const std::string& msg) const;
+
+        // 日志追加写到path，为空时写到标准输出(默认)；打开失败时返回false，继续写原来的位置
+        bool setLogFile(const std::string& path);
+        // 重新打开日志文件(被logrotate等移走之后)，写标准输出时什么也不做
+        void reopen();
 
     private:
-        int logLevel_;
+        std::string path_;                    // 日志文件的路径，为空时写到标准输出
+        std::unique_ptr<std::ofstream> file_;
+        mutable std::mutex mutex_;            // 保护file_，多个loop线程会同时写日志
     };
 
 typedef kvDB::Singleton<Logger> Singleton_Logger;
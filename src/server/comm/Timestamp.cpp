@@ -9,6 +9,7 @@
   */
 
 #include <sys/time.h>
+#include <ctime>
 #include "Timestamp.h"
 
 namespace kvDB {
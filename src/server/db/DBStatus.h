@@ -38,6 +38,11 @@ namespace kvDB {
             return DBStatus(kIOError, msg);
         }
 
+        /* 服务过载，命令没有执行，客户端可以稍后重试 */
+        static DBStatus busy(const std::string & msg){
+            return DBStatus(kBusy, msg);
+        }
+
         std::string toString(){
             if(msg_ == ""){
                 return "OK";
@@ -53,6 +58,9 @@ namespace kvDB {
                     case kIOError:
                         type = "IO Error: ";
                         break;
+                    case kBusy:
+                        type = "Busy: ";
+                        break;
                     default:
                         break;
                 }
@@ -62,11 +70,20 @@ namespace kvDB {
             }
         }
 
+        /* RESP的错误文本，以错误码开头: 过载为 "BUSY msg"，其他为 "ERR 旧协议文本" */
+        std::string toRespError(){
+            if(dbState_ == kBusy){
+                return "BUSY " + msg_;
+            }
+            return "ERR " + toString();
+        }
+
     private:
         enum resCode {
             kOK = 0,
             kNotFound,
-            kIOError
+            kIOError,
+            kBusy
         };
 
         int dbState_;
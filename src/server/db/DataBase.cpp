@@ -16,12 +16,60 @@
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <cfloat>
+#include <charconv>
+#include <cstdlib>
 #include <iostream>
 #include "DBObj.h"
 #include "DBStatus.h"
 #include "../comm/Logger.h"
 
 namespace kvDB {
+    namespace {
+        /* 按长度顺序读取KV0002格式的rdb数据，数据不拷贝，读到的字符串指向data */
+        class RdbReader {
+        public:
+            explicit RdbReader(std::string_view data) : data_(data) {}
+
+            /* data_是否以tag开头，是则跳过tag */
+            bool consume(std::string_view tag) {
+                if (data_.substr(0, tag.size()) != tag) {
+                    return false;
+                }
+                data_.remove_prefix(tag.size());
+                return true;
+            }
+
+            /* 读取以'\n'结尾的十进制整数 */
+            bool readNumber(int64_t* value) {
+                auto res = std::from_chars(data_.data(), data_.data() + data_.size(), *value);
+                if (res.ec != std::errc() || res.ptr == data_.data() + data_.size() || *res.ptr != '\n') {
+                    return false;
+                }
+                data_.remove_prefix(static_cast<size_t>(res.ptr + 1 - data_.data()));
+                return true;
+            }
+
+            /* 读取 $len\n 和之后的len字节，内容不扫描 */
+            bool readString(std::string_view* str) {
+                int64_t len = 0;
+                if (!consume("$") || !readNumber(&len) || len < 0 || static_cast<uint64_t>(len) > data_.size()) {
+                    return false;
+                }
+                *str = data_.substr(0, static_cast<size_t>(len));
+                data_.remove_prefix(static_cast<size_t>(len));
+                return true;
+            }
+
+            /* 读取集合的元素个数 *count\n */
+            bool readCount(int64_t* count) {
+                return consume("*") && readNumber(count) && *count >= 0;
+            }
+
+        private:
+            std::string_view data_;
+        };
+    }
+
     void Database::rdbLoad(int index) {
         char tmp[1024]{0};
         /* 获取rdb文件的保存路径 */
@@ -33,7 +81,10 @@ namespace kvDB {
         // 获取文件信息
         struct stat buf;
         fstat(fd, &buf);
-        if (buf.st_size == 0) return;
+        if (buf.st_size == 0) {
+            close(fd);
+            return;
+        }
 
         /* 使用mmap将rdb文件只读共享映射到内存 */
         char* addr = static_cast<char *>(mmap(NULL, buf.st_size, PROT_READ, MAP_SHARED, fd, 0));
@@ -42,10 +93,90 @@ namespace kvDB {
             LOG_FATAL("rdbSave error");
         }
         close(fd);
-        /* 将映射到内存的rdb文件保存为string，关闭映射内存 */
-        std::string data(addr, addr + buf.st_size);
-        assert(munmap(addr, buf.st_size) != -1);
+        std::string_view data(addr, static_cast<size_t>(buf.st_size));
+        if (data.substr(0, 6) == "KV0002") {
+            /* 直接在映射的内存上解析，value只在放进数据库时拷贝一次 */
+            if (!rdbLoadBinary(data.substr(6), index)) {
+                LOG_ERROR("dump.rdb is corrupted, db %d is partially loaded", index);
+            }
+        } else {
+            rdbLoadText(std::string(data), index);
+        }
+        munmap(addr, buf.st_size);
+    }
 
+    bool Database::rdbLoadBinary(std::string_view data, int index) {
+        RdbReader reader(data);
+        while (!reader.consume("EOF")) {
+            int64_t dbIdx = 0;
+            if (!reader.consume("SD") || !reader.readNumber(&dbIdx)) {
+                return false;
+            }
+            // 其他数据库的数据只解析不载入
+            const bool load = dbIdx == index;
+            while (reader.consume("^")) {
+                int64_t type = 0;
+                if (!reader.readNumber(&type)) {
+                    return false;
+                }
+                while (reader.consume("ST")) {
+                    int64_t expireTime = 0;
+                    std::string_view key;
+                    if (!reader.readNumber(&expireTime) || !reader.readString(&key)) {
+                        return false;
+                    }
+                    // 保存之后已经过期的key只解析不载入
+                    const int64_t remain = expireTime - Timestamp::now().microSecondsSinceEpoch();
+                    const bool loadKey = load && (expireTime <= 0 || remain > 0);
+                    const std::string keyStr(key);
+                    std::string_view value, field;
+                    int64_t count = 0;
+                    if (type == kvDB::dbString) {
+                        if (!reader.readString(&value)) {
+                            return false;
+                        }
+                        if (loadKey) {
+                            addKey(kvDB::dbString, keyStr, std::string(value), kvDB::defaultObjValue);
+                        }
+                    } else if (type == kvDB::dbList || type == kvDB::dbSet) {
+                        if (!reader.readCount(&count)) {
+                            return false;
+                        }
+                        while (count--) {
+                            if (!reader.readString(&value)) {
+                                return false;
+                            }
+                            if (loadKey) {
+                                addKey(static_cast<int>(type), keyStr, std::string(value), kvDB::defaultObjValue);
+                            }
+                        }
+                    } else if (type == kvDB::dbHash || type == kvDB::dbZSet) {
+                        // Hash: field value  ZSet: member score
+                        if (!reader.readCount(&count)) {
+                            return false;
+                        }
+                        while (count--) {
+                            if (!reader.readString(&field) || !reader.readString(&value)) {
+                                return false;
+                            }
+                            if (loadKey) {
+                                addKey(static_cast<int>(type), keyStr, std::string(field), std::string(value));
+                            }
+                        }
+                    } else {
+                        return false;
+                    }
+                    if (loadKey && expireTime > 0) {
+                        setPExpireTime(static_cast<int>(type), keyStr,
+                                       static_cast<double>(remain) / Timestamp::kMicroSecondsPerMilliSecond);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    void Database::rdbLoadText(const std::string& data, int index) {
         int p1 = 0, p2 = 0;
         int dbIdx = 0;
         do {
@@ -212,53 +343,47 @@ namespace kvDB {
         }
     }
 
-    bool Database::addKey(const int type, const std::string& key, const std::string& objKey,
-                          const std::string& objValue) {
+    bool Database::addKey(const int type, const std::string& key, std::string objKey, std::string objValue) {
         // 若为字符串类型
         if (type == kvDB::dbString) {
-            auto it = String_.find(key);
-            if (it == String_.end()) {
-                String_.insert(std::make_pair(key, objKey));
-            } else {
-                String_[key] = objKey;
-            }
+            String_[key] = std::make_shared<const std::string>(std::move(objKey));
         } else if (type == kvDB::dbList) {
             auto it = List_.find(key);
             if (it == List_.end()) {
                 std::list<std::string, __gnu_cxx::__pool_alloc<std::string>> tmp;
-                tmp.emplace_back(objKey);
-                List_.insert(std::make_pair(key, tmp));
+                tmp.emplace_back(std::move(objKey));
+                List_.emplace(key, std::move(tmp));
             } else {
-                it->second.emplace_back(objKey);
+                it->second.emplace_back(std::move(objKey));
             }
         } else if (type == kvDB::dbHash) {
             auto it = Hash_.find(key);
             if (it == Hash_.end()) {
                 std::map<std::string, std::string, std::less<>, __gnu_cxx::__pool_alloc<std::pair<const std::string, std::string>>> tmp;
-                tmp.insert(std::make_pair(objKey, objValue));
-                Hash_.insert(std::make_pair(key, tmp));
+                tmp.emplace(std::move(objKey), std::move(objValue));
+                Hash_.emplace(key, std::move(tmp));
             } else {
-                it->second[objKey] = objValue;
+                it->second[std::move(objKey)] = std::move(objValue);
             }
         } else if (type == kvDB::dbSet) {
             auto it = Set_.find(key);
             if (it == Set_.end()) {
                 std::unordered_set<std::string, std::hash<std::string>, std::equal_to<>, __gnu_cxx::__pool_alloc<std::string>> tmp;
-                tmp.insert(objKey);
-                Set_.insert(std::make_pair(key, tmp));
+                tmp.insert(std::move(objKey));
+                Set_.emplace(key, std::move(tmp));
             } else {
-                it->second.insert(objKey);
+                it->second.insert(std::move(objKey));
             }
         } else if (type == kvDB::dbZSet) {
             auto it = ZSet_.find(key);
             if (it == ZSet_.end()) {
                 SP_SkipList skipList(new SkipList());
-                skipList->insertNode(objKey, atoi(objValue.c_str()));
+                skipList->insertNode(objKey, std::strtod(objValue.c_str(), nullptr));
 
                 ZSet_.insert(std::make_pair(key, skipList));
             } else {
                 auto iter = ZSet_.find(key);
-                iter->second->insertNode(objKey, atoi(objValue.c_str()));
+                iter->second->insertNode(objKey, std::strtod(objValue.c_str(), nullptr));
             }
         } else {
             std::cout << "Unknown type" << std::endl;
@@ -315,7 +440,7 @@ namespace kvDB {
                 if (it == String_.end()) {
                     res = DBStatus::notFound("key").toString();
                 } else {
-                    res = it->second;
+                    res = *it->second;
                 }
             } else if (type == kvDB::dbHash) {
                 auto it = Hash_.find(key);
@@ -355,7 +480,7 @@ namespace kvDB {
                     RangeSpec range(low, high);
                     std::vector<SkipListNode *> nodes(it->second->getNodeInRange(range));
                     for (auto node: nodes) {
-                        res += node->obj_ + ':' + std::to_string(node->score_) + '\n';
+                        res += node->obj_ + ':' + scoreToString(node->score_) + '\n';
                     }
                     res.pop_back();
                 }
@@ -368,6 +493,15 @@ namespace kvDB {
         return res;
     }
 
+    StringValue Database::getStringValue(const std::string& key) {
+        if (judgeKeyExpiredTime(kvDB::dbString, key)) {
+            delKey(kvDB::dbString, key);
+            return nullptr;
+        }
+        auto it = String_.find(key);
+        return it == String_.end() ? nullptr : it->second;
+    }
+
     bool Database::setPExpireTime(const int type, const std::string &key, double expiredTime /* milliSeconds*/) {
         if (type == kvDB::dbString) {
             auto it = String_.find(key);
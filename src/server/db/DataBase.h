@@ -16,6 +16,7 @@
 #include <memory>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <list>
 #include <map>
 #include <unordered_set>
@@ -32,7 +33,10 @@ namespace kvDB {
                                         __gnu_cxx::__pool_alloc<std::pair<const T1, T2>>>;
 
 
-        typedef Dict<std::string, std::string> String;
+        /* String类型的value不可修改，set时整体替换；用shared_ptr保存，发送回复时不用拷贝，
+         * 零拷贝发送期间value即使被覆盖或删除也保持有效 */
+        typedef std::shared_ptr<const std::string> StringValue;
+        typedef Dict<std::string, StringValue> String;
         typedef Dict<std::string, std::list<std::string, __gnu_cxx::__pool_alloc<std::string>>> List;
         typedef Dict<std::string, std::map<std::string, std::string, std::less<>, __gnu_cxx::__pool_alloc<std::pair<const std::string, std::string>>>> Hash;
         typedef Dict<std::string, std::unordered_set<std::string, std::hash<std::string>, std::equal_to<>, __gnu_cxx::__pool_alloc<std::string>>> Set;
@@ -46,12 +50,11 @@ namespace kvDB {
 
             ~Database() = default;
 
-            /* 导入持久化的rdb文件 */
+            /* 导入持久化的rdb文件中第index个数据库 */
             void rdbLoad(int index);
 
-            /* 添加K-V */
-            bool addKey(const int type, const std::string& key, const std::string& objKey,
-                        const std::string& objValue);
+            /* 添加K-V，objKey和objValue按值传入并移动到数据库中，调用者传入临时对象时不再拷贝 */
+            bool addKey(const int type, const std::string& key, std::string objKey, std::string objValue);
 
             /* 删除K-V */
             bool delKey(const int type, const std::string& key);
@@ -60,6 +63,9 @@ namespace kvDB {
              * lazy delete，在get的时候删除*/
             std::string getKey(const int type, const std::string& key);
 
+            /* 查找dbString类型的value，不存在或者已经过期时返回nullptr(过期的key被删除) */
+            StringValue getStringValue(const std::string& key);
+
             /* 设置过期时间，入参expiredTime： expiredTime毫秒后过期 */
             bool setPExpireTime(const int type, const std::string& key, double expiredTime);
 
@@ -121,6 +127,13 @@ namespace kvDB {
             }
 
         private:
+            /* 解析KV0002格式(去掉文件头之后)的rdb数据，所有字符串都带长度前缀，可以包含任意字节.
+             * 数据不完整或格式错误时返回false，之前已经解析的key保留 */
+            bool rdbLoadBinary(std::string_view data, int index);
+
+            /* 解析旧的KV0001格式的rdb数据(字符串中不能出现分隔符) */
+            void rdbLoadText(const std::string& data, int index);
+
             /* 截取p1-p2的字符串*/
             std::string interceptString(const std::string& ss, int p1, int p2);
 
@@ -12,6 +12,7 @@
 #include "SkipList.h"
 #include <memory>
 #include <cassert>
+#include <charconv>
 
 namespace kvDB {
     SkipListNode::SkipListNode(const std::string& obj, double score, int level)
@@ -185,4 +186,11 @@ namespace kvDB {
     int SkipList::valueLteMax(double value, RangeSpec& spec) {
         return spec.maxex_ ? (value < spec.max_) : (value <= spec.max_);
     }
-}
\ No newline at end of file
+
+    std::string scoreToString(double score) {
+        /* 不指定格式和精度时to_chars输出最短的、按原值读回不丢精度的形式 */
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof buf, score);
+        return std::string(buf, res.ptr);
+    }
+}
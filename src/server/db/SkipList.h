@@ -90,6 +90,9 @@ namespace kvDB {
         int valueGteMin(double value, RangeSpec& spec);
         int valueLteMax(double value, RangeSpec& spec);
     };
+
+    /* 分值转成能精确还原的最短十进制字符串(如 3、0.1、1e-07)，rdb和回复中的分值都用它 */
+    std::string scoreToString(double score);
 }
 
 #endif //KVDB_SKIPLIST_H
@@ -13,48 +13,111 @@
 #include "../comm/Logger.h"
 #include <fcntl.h>
 #include <unistd.h>
+#include <algorithm>
 
 namespace kvDB {
     Acceptor::Acceptor(EventLoop* loop, const InetAddress& listenAddr)
             : loop_(loop),
-              acceptSocket_(kvDB::createNonblockingOrDie()),
+              listenAddr_(listenAddr),
+              acceptSocket_(kvDB::createNonblockingOrDie(listenAddr.family())),
               acceptChannel_(loop_, acceptSocket_.fd()),
               listening_(false),
-              idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)) {
+              idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+              acceptBudget_(64),
+              backlog_(1024) {
 
-        acceptSocket_.setReuseAddr(true);
-        acceptSocket_.setReusePort(true);
-        acceptSocket_.bindAddress(listenAddr);
+        if (listenAddr_.isUnix()) {
+            /* 上次运行残留的socket文件会导致bind失败 */
+            ::unlink(listenAddr_.toIp().c_str());
+        } else {
+            acceptSocket_.setReuseAddr(true);
+            acceptSocket_.setReusePort(true);
+        }
+        acceptSocket_.bindAddress(listenAddr_);
 
         acceptChannel_.setReadCallback(std::bind(&Acceptor::handleRead, this));
     }
 
+    Acceptor::~Acceptor() {
+        loop_->cancel(resumeTimer_);
+        if (listening_) {
+            acceptChannel_.disableAll();
+            acceptChannel_.remove();
+        }
+        ::close(idleFd_);
+        if (listenAddr_.isUnix()) {
+            ::unlink(listenAddr_.toIp().c_str());
+        }
+    }
+
+    void Acceptor::setDeferAccept(int seconds) {
+        if (!listenAddr_.isUnix()) {
+            acceptSocket_.setDeferAccept(seconds);
+        }
+    }
+
     void Acceptor::listen() {
         loop_->assertInLoopThread();
         listening_ = true;
-        acceptSocket_.listen();
+        acceptSocket_.listen(backlog_);
         acceptChannel_.enableReading();
     }
 
     void Acceptor::handleRead() {
         loop_->assertInLoopThread();
-        InetAddress peerAddr;
-        int connfd = acceptSocket_.accept(&peerAddr);
-        if (connfd >= 0) {
-            if (newConnectionCallback_) {
-                newConnectionCallback_(connfd, peerAddr);
+        if (admissionCallback_ && !admissionCallback_()) {
+            /* 过载时先把loop留给已经接收的请求，不再引入新连接 */
+            ++stats_.paused;
+            acceptChannel_.disableReading();
+            resumeTimer_ = loop_->runAfter(kAdmissionRetry, std::bind(&Acceptor::resume, this));
+            return;
+        }
+        ++stats_.wakeups;
+        /* 每次事件accept到EAGAIN为止，但最多acceptBudget_个，连接风暴时不会长时间占住loop.
+         * 用完预算时，水平触发下一轮poll会再通知; 边沿触发不会再通知，在本轮的pendingFunctors中继续 */
+        uint64_t accepted = 0;
+        int i = 0;
+        for (; i < acceptBudget_; ++i) {
+            InetAddress peerAddr;
+            int connfd = acceptSocket_.accept(&peerAddr);
+            if (connfd >= 0) {
+                ++accepted;
+                if (newConnectionCallback_) {
+                    newConnectionCallback_(connfd, peerAddr);
+                } else {
+                    ::close(connfd);
+                }
             } else {
-                ::close(connfd);
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                LOG_ERROR("%s:%s:%d accept socket create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
+                if (errno == EMFILE) {
+                    ::close(idleFd_);
+                    idleFd_ = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+                    ::close(idleFd_);
+                    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+                } else if (errno != EINTR && errno != ECONNABORTED) {
+                    break;
+                }
             }
-        } else {
-            LOG_ERROR("%s:%s:%d accept socket create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
-            if (errno == EMFILE) {
-                ::close(idleFd_);
-                idleFd_ = ::accept(acceptSocket_.fd(), nullptr, nullptr);
-                ::close(idleFd_);
-                idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+        }
+
+        stats_.accepted += accepted;
+        stats_.maxPerWakeup = std::max(stats_.maxPerWakeup, accepted);
+        if (i == acceptBudget_) {
+            ++stats_.budgetExhausted;
+            if (acceptChannel_.isEdgeTriggered()) {
+                loop_->queueInLoop(std::bind(&Acceptor::handleRead, this));
             }
         }
     }
 
-}
\ No newline at end of file
+
+    void Acceptor::resume() {
+        resumeTimer_ = TimerId();
+        if (listening_ && !acceptChannel_.isReading()) {
+            acceptChannel_.enableReading();
+        }
+    }
+}
@@ -23,14 +23,42 @@ namespace kvDB {
     class Acceptor : Noncopyable {
     public:
         using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
+        using AdmissionCallback = std::function<bool()>;
 
+        /* accept的统计，只在所属的loop中修改 */
+        struct Stats {
+            uint64_t wakeups = 0;          // 处理读事件的次数(包括用完预算后的继续)
+            uint64_t accepted = 0;         // accept到的连接数
+            uint64_t maxPerWakeup = 0;     // 一次读事件最多accept到的连接数
+            uint64_t budgetExhausted = 0;  // 用完预算、还有连接没有accept的次数
+            uint64_t paused = 0;           // 过载时暂停accept的次数
+        };
+
+        /* listenAddr可以是TCP地址或者Unix域套接字的路径，Unix域套接字绑定前删除残留的同名文件 */
         Acceptor(EventLoop* loop, const InetAddress& listenAddr);
+        ~Acceptor();
 
         /* 设置新的Tcp连接执行的回调 */
         void setNewConnectionCallback(const NewConnectionCallback& cb) {
             newConnectionCallback_ = cb;
         }
 
+        /* 设置准入检查: 有新连接时先调用cb，返回false(服务过载)时暂停accept，
+         * 新连接留在内核的backlog中，kAdmissionRetry秒后再检查 */
+        void setAdmissionCallback(const AdmissionCallback& cb) { admissionCallback_ = cb; }
+
+        /* 设置监听fd为边沿触发，必须在listen之前调用 */
+        void setEdgeTriggered(bool on) { acceptChannel_.setEdgeTriggered(on); }
+
+        /* 每次读事件最多accept的连接数，默认64 */
+        void setAcceptBudget(int budget) { acceptBudget_ = budget > 0 ? budget : 1; }
+
+        /* 设置listen的backlog，必须在listen之前调用，默认1024 */
+        void setBacklog(int backlog) { backlog_ = backlog; }
+
+        /* 设置TCP_DEFER_ACCEPT(秒)，连接收到数据之后才accept，Unix域套接字忽略 */
+        void setDeferAccept(int seconds);
+
         /* 监听Acceptor实例中Socket类的fd，设置fd关心读事件 */
         void listen();
 
@@ -39,16 +67,32 @@ namespace kvDB {
             return listening_;
         }
 
+        /* 监听的地址 */
+        const InetAddress& listenAddress() const { return listenAddr_; }
+
+        const Stats& stats() const { return stats_; }
+
     private:
+        static constexpr double kAdmissionRetry = 0.01;   // 暂停accept之后再次检查的间隔(秒)
+
         void handleRead();
 
+        /* 暂停之后恢复关心读事件 */
+        void resume();
+
         EventLoop* loop_;          // 运行的循环
+        InetAddress listenAddr_;   // 监听的地址
         Socket acceptSocket_;      // 网络socket
         Channel acceptChannel_;    // fd监听
 
         NewConnectionCallback newConnectionCallback_;  // 新连接到来执行的回调
+        AdmissionCallback admissionCallback_;          // 是否允许accept新连接
+        TimerId resumeTimer_;            // 暂停accept之后恢复的定时器
         bool listening_;                 // 是否已经监听了Socket中的fd，fd关心读事件
         int idleFd_;                     // 防文件描述符耗尽
+        int acceptBudget_;               // 每次读事件最多accept的连接数
+        int backlog_;                    // listen的backlog
+        Stats stats_;                    // accept的统计
     };
 }
 
@@ -16,26 +16,67 @@ namespace kvDB {
 
     const char Buffer::kCRLF[] = "\r\n";
 
+    char Buffer::kEmpty_[kCheapPrepend];
+
     Buffer::Buffer()
-            :buffer_(kCheapPrepend + kInitialSize),
+            :data_(kEmpty_),
+             capacity_(kCheapPrepend),
              readerIndex_(kCheapPrepend),
              writerIndex_(kCheapPrepend){
 
         assert(readableBytes() == 0);
-        assert(writableBytes() == kInitialSize);
+        assert(writableBytes() == 0);
         assert(prependableBytes() == kCheapPrepend);
     }
 
-    /* 使用vector::swap和std::swap，这样就不需要涉及数据拷贝 */
+    Buffer::~Buffer() {
+        release();
+    }
+
+    /* 只交换内存块指针和索引，不需要涉及数据拷贝 */
     void Buffer::swap(Buffer& rhs) {
-        buffer_.swap(rhs.buffer_);
+        std::swap(data_, rhs.data_);
+        std::swap(capacity_, rhs.capacity_);
         std::swap(readerIndex_,rhs.readerIndex_);
         std::swap(writerIndex_,rhs.writerIndex_);
     }
 
+    void Buffer::reallocate(size_t size) {
+        size_t capacity = 0;
+        char* chunk = BufferPool::instance().allocate(size, &capacity);
+        const size_t readable = readableBytes();
+        assert(kCheapPrepend + readable <= capacity);
+        ::memcpy(chunk + kCheapPrepend, peek(), readable);
+        release();
+        data_ = chunk;
+        capacity_ = capacity;
+        readerIndex_ = kCheapPrepend;
+        writerIndex_ = kCheapPrepend + readable;
+    }
+
+    void Buffer::release() {
+        if (data_ != kEmpty_) {
+            BufferPool::instance().deallocate(data_, capacity_);
+        }
+        data_ = kEmpty_;
+        capacity_ = kCheapPrepend;
+    }
+
+    void Buffer::shrink() {
+        const size_t readable = readableBytes();
+        if (readable == 0) {
+            release();
+            readerIndex_ = kCheapPrepend;
+            writerIndex_ = kCheapPrepend;
+        } else if (capacity_ > kInitialSize && (kCheapPrepend + readable) * 4 <= capacity_) {
+            reallocate(kCheapPrepend + readable);
+        }
+    }
+
     ssize_t Buffer::readFd(int fd, int* savedErrno) {
         // saved an ioctl()/FIONREAD call to tell how much to read
-        char extrabuf[65536];
+        allocate();
+        char extrabuf[kExtraBufSize];
         struct iovec vec[2];
         const size_t writable = writableBytes();
         vec[0].iov_base = begin() + writerIndex_;
@@ -55,7 +96,7 @@ namespace kvDB {
             //当读去的数据超过Buffer可写空间时，
             //就用到了栈空间，这时要将栈中的数据
             //存入到Buffer中。
-            writerIndex_ = buffer_.size();
+            writerIndex_ = capacity_;
             append(extrabuf,n - writable);
         }
         return n;
@@ -3,7 +3,7 @@
   * @file           : Buffer.h
   * @author         : zgys
   * @brief          : 应用层buffer， 参考Muduo
-  * @attention      : None
+  * @attention      : 内存块来自当前线程的BufferPool，延迟分配，空闲时归还
   * @date           : 23-3-23
   ******************************************************************************
   */
@@ -17,23 +17,29 @@
 #include <cassert>
 #include <string>
 #include <algorithm>
+#include <cstring>
+#include "BufferPool.h"
+#include "../comm/Noncopyable.h"
 
 namespace kvDB {
 
     /* 应用层缓冲区
                   * +-------------+------------+-------------+
-    vector<char>  * | prependable |  readable  |   writable  |
+    chunk         * | prependable |  readable  |   writable  |
                   * +-------------+------------+-------------+
                   * |             |            |             |
-                  * 0         readIndex_   writeIndex_     size
-     */
-    class Buffer {
+                  * 0         readIndex_   writeIndex_   capacity_
+     * 内存块从BufferPool中按2的幂分配，扩容时只拷贝可读数据，不做初始化.
+     * 构造时不分配内存，读取数据时才分配；shrink()在数据取完时归还内存块，
+     * 在大请求处理完后换成较小的内存块，所以空闲连接的Buffer只占用对象本身的几十个字节 */
+    class Buffer : Noncopyable {
     public:
         static const size_t kCheapPrepend = 8;     // 预留空间
-        static const size_t kInitialSize  = 1024;  // Buffer初始化大小
+        static const size_t kInitialSize  = 1024;  // 第一次分配的内存块大小(包含预留空间)
+        static const size_t kExtraBufSize = 65536; // readFd时栈上临时缓冲区的大小
 
         Buffer();
-        ~Buffer() = default;
+        ~Buffer();
 
         /* 交换两个应用层buff */
         void swap(Buffer& rhs);
@@ -41,11 +47,24 @@ namespace kvDB {
         /* 从内核协议栈的缓存区读取到应用层buffer */
         ssize_t readFd(int fd, int* savedErrno);
 
+        /* 还没有内存块时分配初始的内存块 */
+        void allocate() {
+            if (data_ == kEmpty_) {
+                reallocate(kInitialSize);
+            }
+        }
+
+        /* 数据取完时把内存块归还给BufferPool；剩余数据不到内存块的1/4时换成较小的内存块 */
+        void shrink();
+
+        /* 当前内存块的大小，没有分配时为0 */
+        size_t capacity() const { return data_ == kEmpty_ ? 0 : capacity_; }
+
         /* buffer中可读的字节数 */
         size_t readableBytes() const { return writerIndex_ - readerIndex_; }
 
         /* buffer中可写的字节数 */
-        size_t writableBytes() const { return buffer_.size() - writerIndex_; }
+        size_t writableBytes() const { return capacity_ - writerIndex_; }
 
         /* 前置预留空间大小，一般是0~readerIndex_的范围 */
         size_t prependableBytes() const { return readerIndex_; }
@@ -115,6 +134,7 @@ namespace kvDB {
 
         /* 添加预分配数据 */
         void prepend(const void* data, size_t len) {
+            allocate();
             // 预分配空间要大于要添加的数据
             assert(len <= prependableBytes());
             readerIndex_ -= len; // 将读索引前移
@@ -143,21 +163,27 @@ namespace kvDB {
             return crlf == beginWrite() ? nullptr : crlf;
         }
 
+        /* 查找可读数据中第一个'\n'，用memchr逐字查找比std::search快，没有找到时返回nullptr */
+        const char* findEOL() const {
+            const void* eol = memchr(peek(), '\n', readableBytes());
+            return static_cast<const char*>(eol);
+        }
+
     private:
         char* begin() {
-            return &*buffer_.begin();
+            return data_;
         }
 
         const char* begin() const {
-            return &*buffer_.begin();
+            return data_;
         }
 
         void makeSpace(size_t len) {
             if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
-                //可写空间不满足时，要重新分配内存，
-                //这里用到了std::vector::resize，会对冲洗分配的内存初始化
-                // FIXME: move readable data
-                buffer_.resize(writerIndex_ + len);
+                //可写空间不满足时，从BufferPool换一个更大的内存块，只拷贝可读数据.
+                //至少扩大一倍: BufferPool不会把超过kMaxChunkSize的请求向上取整，
+                //按需要的大小分配会让大请求每次读socket都重新分配并拷贝整个缓冲区
+                reallocate(std::max(capacity_ * 2, kCheapPrepend + readableBytes() + len));
             } else {
                 //当可写空间满足要写入数据的长度时，
                 //1、将可读数据往前拷贝（拷贝的首地址就是相对内存起始地址偏移kCheapPrepend）.
@@ -165,20 +191,26 @@ namespace kvDB {
                 // move readable data to the front, make space inside buffer
                 assert(kCheapPrepend < readerIndex_);
                 size_t readable = readableBytes();
-                std::copy(begin() + readerIndex_,
-                          begin() + writerIndex_,
-                          begin() + kCheapPrepend);
+                ::memmove(begin() + kCheapPrepend, begin() + readerIndex_, readable);
                 readerIndex_ = kCheapPrepend;
                 writerIndex_ = readerIndex_ + readable;
                 assert(readable == readableBytes());
             }
         }
 
+        /* 换成至少size字节的内存块，可读数据移动到新内存块的kCheapPrepend处 */
+        void reallocate(size_t size);
+
+        /* 把内存块归还给BufferPool */
+        void release();
+
     private:
-        std::vector<char> buffer_;  // Buffer实体
+        char*  data_;               // 内存块，没有分配时指向kEmpty_
+        size_t capacity_;           // 内存块大小，没有分配时为kCheapPrepend
         size_t readerIndex_;        // 可读索引
         size_t writerIndex_;        // 可写索引
 
+        static char kEmpty_[kCheapPrepend];  // 没有分配内存块时的占位，不会被写入
         static const char kCRLF[];  // 字符串结束标识“\r\n”
     };
 }
@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file           : BufferPool.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-17
+  ******************************************************************************
+  */
+
+
+#include "BufferPool.h"
+#include "../comm/Logger.h"
+#include <cstdlib>
+
+namespace kvDB {
+    BufferPool& BufferPool::instance() {
+        thread_local BufferPool pool;
+        return pool;
+    }
+
+    BufferPool::~BufferPool() {
+        for (auto& freeList : freeLists_) {
+            for (char* chunk : freeList) {
+                ::free(chunk);
+            }
+        }
+    }
+
+    int BufferPool::sizeClass(size_t size) {
+        if (size > kMaxChunkSize) {
+            return -1;
+        }
+        int index = 0;
+        size_t chunkSize = kMinChunkSize;
+        while (chunkSize < size) {
+            chunkSize <<= 1;
+            ++index;
+        }
+        return index;
+    }
+
+    char* BufferPool::allocate(size_t size, size_t* capacity) {
+        const int index = sizeClass(size);
+        if (index < 0) {
+            // 大块内存按页对齐直接分配
+            *capacity = (size + 4095) & ~static_cast<size_t>(4095);
+        } else {
+            *capacity = kMinChunkSize << index;
+            auto& freeList = freeLists_[index];
+            if (!freeList.empty()) {
+                char* chunk = freeList.back();
+                freeList.pop_back();
+                cachedBytes_ -= *capacity;
+                return chunk;
+            }
+        }
+        auto* chunk = static_cast<char*>(::malloc(*capacity));
+        if (chunk == nullptr) {
+            LOG_FATAL("BufferPool::allocate %zu bytes failed.\n", *capacity);
+        }
+        return chunk;
+    }
+
+    void BufferPool::deallocate(char* chunk, size_t capacity) {
+        const int index = sizeClass(capacity);
+        if (index >= 0 && (freeLists_[index].size() + 1) * capacity <= kMaxCachedBytes) {
+            freeLists_[index].push_back(chunk);
+            cachedBytes_ += capacity;
+        } else {
+            ::free(chunk);
+        }
+    }
+}
@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file           : BufferPool.h
+  * @author         : zgys
+  * @brief          : Buffer使用的内存块池，按2的幂分级缓存内存块
+  * @attention      : 每个线程一个实例(one loop per thread，即每个EventLoop一个)，不需要加锁
+  * @date           : 23-4-17
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_BUFFERPOOL_H
+#define KVDB_BUFFERPOOL_H
+
+#include <cstddef>
+#include <vector>
+#include "../comm/Noncopyable.h"
+
+namespace kvDB {
+    class BufferPool : Noncopyable {
+    public:
+        static const size_t kMinChunkSize   = 1024;              // 最小的内存块
+        static const size_t kMaxChunkSize   = 1024 * 1024;       // 超过此大小的内存块不缓存，直接malloc/free
+        static const size_t kMaxCachedBytes = 4 * 1024 * 1024;   // 每一级最多缓存的字节数
+        static const int    kNumClasses     = 11;                // 1KB ~ 1MB
+
+        /* 当前线程的内存块池 */
+        static BufferPool& instance();
+
+        /* 分配至少size字节的内存块，实际大小写入capacity，内存不初始化 */
+        char* allocate(size_t size, size_t* capacity);
+
+        /* 归还allocate分配的内存块，capacity为allocate返回的大小 */
+        void deallocate(char* chunk, size_t capacity);
+
+        /* 池中缓存的字节数 */
+        size_t cachedBytes() const { return cachedBytes_; }
+
+        ~BufferPool();
+
+    private:
+        BufferPool() : cachedBytes_(0) {}
+
+        /* size对应的级别，超过kMaxChunkSize时返回-1 */
+        static int sizeClass(size_t size);
+
+        std::vector<char*> freeLists_[kNumClasses];
+        size_t cachedBytes_;
+    };
+}
+
+#endif //KVDB_BUFFERPOOL_H
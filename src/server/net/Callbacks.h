@@ -25,11 +25,16 @@ namespace kvDB {
 
     /* 定时器的回调 */
     using TimerCallback = std::function<void()>;
+    /* 信号的回调，参数是信号值，在loop线程中执行 */
+    using SignalCallback = std::function<void(int signo)>;
     using ConnectionCallback = std::function<void(const TcpConnectionPtr&)>;
     /* Tcp连接读事件到来时，从内核取数据到应用层Buffer后执行的回调 */
     using MessageCallback = std::function<void(const TcpConnectionPtr&, Buffer* buf, Timestamp)>;
     using WriteCompleteCallback = std::function<void(const TcpConnectionPtr&)>;
     using CloseCallback = std::function<void(const TcpConnectionPtr&)>;
+    /* 发送链中待发送的字节数超过高水位/回落到低水位时执行的回调，第二个参数是当前待发送的字节数 */
+    using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
+    using LowWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
 
     /* 默认连接，一个连接到来执行的回调，打印连接的信息 */
     void defaultConnectionCallback(const TcpConnectionPtr& conn);
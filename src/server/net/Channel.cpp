@@ -11,11 +11,13 @@
 
 #include "Channel.h"
 #include <sys/epoll.h>
+#include <cassert>
 
 namespace kvDB {
     const int Channel::kNoneEvent = 0;
     const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
     const int Channel::kWriteEvent = EPOLLOUT;
+    const int Channel::kEdgeTriggered = EPOLLET | EPOLLRDHUP;
 
     Channel::Channel(EventLoop *loop, int fd)
             : loop_(loop),
@@ -29,6 +31,15 @@ namespace kvDB {
 
     Channel::~Channel() = default;
 
+    void Channel::reset(int fd) {
+        assert(index_ == -1);
+        fd_ = fd;
+        events_ = 0;
+        revents_ = 0;
+        tie_.reset();
+        tied_ = false;
+    }
+
     void Channel::tie(const std::shared_ptr<void>& obj) {
         tie_ = obj;
         tied_ = true;
@@ -38,6 +49,10 @@ namespace kvDB {
         loop_->updateChannel(this);
     }
 
+    void Channel::remove() {
+        loop_->removeChannel(this);
+    }
+
     void Channel::handleEvent(Timestamp receiveTime) {
         std::shared_ptr<void> guard;
         if(tied_){
@@ -51,6 +66,10 @@ namespace kvDB {
     }
 
     void Channel::handleEventWithGuard(Timestamp receiveTime) {
+        /* 对端关闭且没有数据可读 */
+        if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN)) {
+            if (closeCallback_) closeCallback_();
+        }
         if (revents_ & EPOLLERR) {
             if (errorCallback_) errorCallback_();
         }
@@ -67,6 +86,11 @@ namespace kvDB {
         update();
     }
 
+    void Channel::disableReading() {
+        events_ &= ~kReadEvent;
+        update();
+    }
+
     void Channel::enableWriting() {
         events_ |= kWriteEvent;
         update();
@@ -81,4 +105,12 @@ namespace kvDB {
         events_ = kNoneEvent;
         update();
     }
+
+    void Channel::setEdgeTriggered(bool on) {
+        if (on) {
+            events_ |= kEdgeTriggered;
+        } else {
+            events_ &= ~kEdgeTriggered;
+        }
+    }
 }
\ No newline at end of file
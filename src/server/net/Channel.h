@@ -41,10 +41,11 @@ namespace kvDB {
 
         int fd() const { return fd_; }
         int events() const { return events_; }
+        int revents() const { return revents_; }
         void set_revents(int revt) { revents_ = revt; }
 
-        /* 判断此fd是不是没有监听任何事件 */
-        bool isNoneEvent() const { return events_ == kNoneEvent; }
+        /* 判断此fd是不是没有监听任何事件(不考虑EPOLLET标志) */
+        bool isNoneEvent() const { return (events_ & ~kEdgeTriggered) == kNoneEvent; }
 
         /* 为了防止TcpConnection在运行时，链接被释放掉，用一个弱引用指向它，
          * 一旦使用时， .lock 变成shared_ptr，就不会在使用时释放
@@ -54,6 +55,9 @@ namespace kvDB {
         /* fd添加关心读事件 */
         void enableReading();
 
+        /* fd取消关心读事件 */
+        void disableReading();
+
         /* fd添加关心写事件 */
         void enableWriting();
 
@@ -63,9 +67,26 @@ namespace kvDB {
         /* fd取消关心所有事件 */
         void disableAll();
 
+        /* 设置fd为边沿触发(EPOLLET)，同时关心EPOLLRDHUP，以便读到短包时判断对端是否已关闭。
+         * 在enableReading之前调用，不会单独触发epoll_ctl */
+        void setEdgeTriggered(bool on);
+
+        /* fd是否是边沿触发 */
+        bool isEdgeTriggered() const { return events_ & kEdgeTriggered; }
+
+        /* 从EventLoop中删除此channel */
+        void remove();
+
+        /* 复用channel: 换成新的fd，清空关心的事件和绑定的对象，回调不变.
+         * 只能在channel已经从Poller中删除之后调用 */
+        void reset(int fd);
+
         /* fd是否关心了写事件 */
         bool isWriting() const { return events_ & kWriteEvent; }
 
+        /* fd是否关心了读事件 */
+        bool isReading() const { return events_ & kReadEvent; }
+
         // for Poller
         int index() { return index_; }
         void set_index(int idx) { index_ = idx; }
@@ -83,9 +104,10 @@ namespace kvDB {
         static const int kNoneEvent;
         static const int kReadEvent;
         static const int kWriteEvent;
+        static const int kEdgeTriggered;
 
         EventLoop*          loop_;
-        const int           fd_;           // fd的文件描述符
+        int                 fd_;           // fd的文件描述符
         int                 events_;       // fd监听的事件
         int                 revents_;
         int                 index_;
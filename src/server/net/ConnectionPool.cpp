@@ -0,0 +1,68 @@
+/**
+  ******************************************************************************
+  * @file           : ConnectionPool.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-19
+  ******************************************************************************
+  */
+
+
+#include "ConnectionPool.h"
+#include "TcpConnection.h"
+#include "Channel.h"
+
+namespace kvDB {
+    ConnectionPool::ConnectionPool(EventLoop* loop, size_t maxIdle)
+            : loop_(loop),
+              maxIdle_(maxIdle) {
+    }
+
+    ConnectionPool::~ConnectionPool() {
+        for (TcpConnection* conn : idle_) {
+            delete conn;
+        }
+    }
+
+    TcpConnectionPtr ConnectionPool::acquire(uint64_t id, int sockfd,
+                                             const InetAddress& localAddr, const InetAddress& peerAddr) {
+        TcpConnection* conn = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!idle_.empty()) {
+                conn = idle_.back();
+                idle_.pop_back();
+            }
+        }
+        if (conn == nullptr) {
+            conn = new TcpConnection(loop_, id, sockfd, localAddr, peerAddr);
+        } else {
+            conn->reset(id, sockfd, localAddr, peerAddr);
+        }
+        /* 删除器持有池的shared_ptr，Server析构之后连接才释放时池仍然有效 */
+        auto self = shared_from_this();
+        return TcpConnectionPtr(conn, [self](TcpConnection* c) { self->release(c); });
+    }
+
+    size_t ConnectionPool::idleCount() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return idle_.size();
+    }
+
+    void ConnectionPool::release(TcpConnection* conn) {
+        /* 还注册在Poller中的连接(没有经过connectDestroyed)不能复用 */
+        if (!conn->recycle()) {
+            delete conn;
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (idle_.size() < maxIdle_) {
+                idle_.push_back(conn);
+                return;
+            }
+        }
+        delete conn;
+    }
+}
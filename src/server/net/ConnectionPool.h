@@ -0,0 +1,53 @@
+/**
+  ******************************************************************************
+  * @file           : ConnectionPool.h
+  * @author         : zgys
+  * @brief          : 每个loop一个的TcpConnection对象池，连接关闭后对象(连同Channel、Buffer)被回收复用
+  * @attention      : acquire在baseLoop中调用，回收发生在最后一个shared_ptr释放的线程，所以用锁保护
+  * @date           : 23-4-19
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_CONNECTIONPOOL_H
+#define KVDB_CONNECTIONPOOL_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Callbacks.h"
+#include "InetAddress.h"
+#include "../comm/Noncopyable.h"
+
+namespace kvDB {
+    class EventLoop;
+
+    class ConnectionPool : Noncopyable, public std::enable_shared_from_this<ConnectionPool> {
+    public:
+        /**
+         * @brief 构造
+         * @param loop 池中连接所属的loop
+         * @param maxIdle 最多缓存的空闲连接对象数，超过的直接释放
+         */
+        explicit ConnectionPool(EventLoop* loop, size_t maxIdle = 4096);
+        ~ConnectionPool();
+
+        /* 取一个连接对象，没有空闲对象时新建.
+         * 返回的shared_ptr引用计数归零时对象回到池中而不是被delete */
+        TcpConnectionPtr acquire(uint64_t id, int sockfd, const InetAddress& localAddr, const InetAddress& peerAddr);
+
+        /* 池中空闲的连接对象数 */
+        size_t idleCount() const;
+
+    private:
+        /* shared_ptr的删除器 */
+        void release(TcpConnection* conn);
+
+        EventLoop* loop_;
+        const size_t maxIdle_;
+        mutable std::mutex mutex_;
+        std::vector<TcpConnection*> idle_;
+    };
+}
+
+#endif //KVDB_CONNECTIONPOOL_H
@@ -0,0 +1,29 @@
+/**
+  ******************************************************************************
+  * @file           : DefaultPoller.cpp
+  * @author         : zgys
+  * @brief          : 创建默认的Poller，单独放在一个文件中，避免Poller基类依赖具体实现
+  * @attention      : None
+  * @date           : 23-4-15
+  ******************************************************************************
+  */
+
+
+#include "Poller.h"
+#include "EpollPoller.h"
+#include "IoUringPoller.h"
+#include "../comm/Logger.h"
+
+namespace kvDB {
+    Poller* Poller::newDefaultPoller(EventLoop* loop) {
+        if (s_defaultBackend_ == kIoUring) {
+            auto* poller = new IoUringPoller(loop);
+            if (poller->init()) {
+                return poller;
+            }
+            delete poller;
+            LOG_WARN("io_uring is not available, fall back to epoll.\n");
+        }
+        return new EpollPoller(loop);
+    }
+}
@@ -11,6 +11,8 @@
 #include <sys/epoll.h>
 #include <cstring>
 #include <cassert>
+#include <algorithm>
+#include <unistd.h>
 #include "EpollPoller.h"
 #include "Channel.h"
 #include "EventLoop.h"
@@ -26,15 +28,16 @@ namespace kvDB {
 
     /* EPOLL_CLOEXEC: 进程被替换时会关闭打开的文件描述符 */
     EpollPoller::EpollPoller(EventLoop* loop)
-            : ownerLoop_(loop),
+            : Poller(loop),
               epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
               events_(kInitEventListSize) {
+        if (epollfd_ < 0) {
+            LOG_FATAL("epoll_create1 error:%d\n", errno);
+        }
     }
 
-    EpollPoller::~EpollPoller() = default;
-
-    void EpollPoller::assertInLoopThread() {
-        ownerLoop_->assertInLoopThread();
+    EpollPoller::~EpollPoller() {
+        ::close(epollfd_);
     }
 
     Timestamp EpollPoller::poll(int timeoutMs, ChannelList* activeChannels) {
@@ -61,10 +64,8 @@ namespace kvDB {
     void EpollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels) const {
         for (int i = 0; i < numEvents; i++) {
             auto channel = static_cast<Channel *>(events_[i].data.ptr);
-            int fd = channel->fd();
-            auto it = channels_.find(fd);
-            if (it == channels_.end() || it->second != channel) {
-                return;
+            if (findChannel(channel->fd()) != channel) {
+                continue;
             }
             channel->set_revents(events_[i].events);
             activeChannels->push_back(channel);
@@ -78,17 +79,20 @@ namespace kvDB {
         if (index == kNew || index == kDelete) {
             int fd = channel->fd();
             if (index == kNew) {
-                if (channels_.find(fd) != channels_.end()) {
+                if (findChannel(fd) != nullptr) {
                     LOG_ERROR("fd = %d must not exist in channels_.", fd);
                     return;
                 }
+                if (static_cast<size_t>(fd) >= channels_.size()) {
+                    channels_.resize(std::max(static_cast<size_t>(fd) + 1, channels_.size() * 2), nullptr);
+                }
                 channels_[fd] = channel;
             }
             channel->set_index(kAdded);
             update(EPOLL_CTL_ADD, channel);
         } else {
             int fd = channel->fd();
-            if (channels_.find(fd) == channels_.end() || channels_[fd] != channel || index != kAdded) {
+            if (findChannel(fd) != channel || index != kAdded) {
                 LOG_ERROR("current channel is not matched current fd, fd = %d, channel = 0x%p", fd, channel);
                 return;
             }
@@ -103,15 +107,11 @@ namespace kvDB {
 
     void EpollPoller::removeChannel(Channel* channel) {
         assertInLoopThread();
-        assert(channels_.find(channel->fd()) != channels_.end());
-        assert(channels_[channel->fd()] == channel);
+        assert(findChannel(channel->fd()) == channel);
         assert(channel->isNoneEvent());
 
         int idx = channel->index();
-        assert(0 <= idx && idx < static_cast<int>(events_.size()));
-
-        size_t n = channels_.erase(channel->fd());
-        assert(n == 1);
+        channels_[channel->fd()] = nullptr;
 
         if(idx == kAdded){
             update(EPOLL_CTL_DEL, channel);
@@ -134,7 +134,9 @@ namespace kvDB {
             } else {
                 LOG_FATAL("epoll_ctl add/mod error:%d\n", errno);
             }
+            return false;
         }
+        return true;
     }
 
 
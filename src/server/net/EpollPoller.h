@@ -13,33 +13,27 @@
 #define KVDB_EPOLLPOLLER_H
 
 #include <vector>
-#include <map>
-#include "../comm/Noncopyable.h"
 #include "../comm/Timestamp.h"
+#include "Poller.h"
 
 namespace kvDB {
 
     class Channel;
     class EventLoop;
 
-    class EpollPoller : Noncopyable {
+    class EpollPoller : public Poller {
     public:
-        using ChannelList = std::vector<Channel*>;
-
         explicit EpollPoller(EventLoop* loop);
-        ~EpollPoller();
+        ~EpollPoller() override;
 
         /* 将epoll_wait返回的事件放入成员 events_ 中, 将fd对应的channel从channels_找出，加入activeChannels */
-        Timestamp poll(int timeoutMs, ChannelList* activeChannels);
+        Timestamp poll(int timeoutMs, ChannelList* activeChannels) override;
 
         /* 更新channel到epoll */
-        void updateChannel(Channel* channel);
+        void updateChannel(Channel* channel) override;
 
         /* 从Poller中删除channel，只有channel中的fd不监听任何事件才可以移除 */
-        void removeChannel(Channel* channel);
-
-        /* 断言是否在循环的线程中 */
-        void assertInLoopThread();
+        void removeChannel(Channel* channel) override;
 
     private:
         void fillActiveChannels(int numEvents, ChannelList* activeChannels) const;
@@ -49,15 +43,20 @@ namespace kvDB {
 
         static const int kInitEventListSize = 16;
         using EventList = std::vector<struct epoll_event>;
-        using ChannelMap = std::map<int, Channel*>;
+        /* 以fd为下标的channel表，fd是进程中最小的可用描述符，所以表是稠密的 */
+        using ChannelMap = std::vector<Channel*>;
 
     private:
-        EventLoop* ownerLoop_;
         int        epollfd_;
         // 缓存epoll_event的数组， 存放epoll_wait返回的事件
         EventList  events_;
-        // fd到Channel的映射
+        // fd到Channel的映射, 没有channel的fd为nullptr
         ChannelMap channels_;
+
+        /* fd对应的channel, 不存在时返回nullptr */
+        Channel* findChannel(int fd) const {
+            return static_cast<size_t>(fd) < channels_.size() ? channels_[fd] : nullptr;
+        }
     };
 
 }
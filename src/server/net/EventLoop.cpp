@@ -11,8 +11,14 @@
 
 #include "EventLoop.h"
 #include "Channel.h"
+#include "TimerQueue.h"
+#include "SignalHandler.h"
 #include "../comm/Logger.h"
 #include <cassert>
+#include <csignal>
+#include <algorithm>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 namespace kvDB {
 
@@ -22,20 +28,62 @@ namespace kvDB {
     // 定义Poller IO复用接口的默认超时时间
     const int kPollTimeMs = 10000;
 
+    /* 向已经关闭的连接写数据会收到SIGPIPE, 默认处理是终止进程, 由write返回的EPIPE处理 */
+    class IgnoreSigPipe {
+    public:
+        IgnoreSigPipe() {
+            ::signal(SIGPIPE, SIG_IGN);
+        }
+    };
+
+    IgnoreSigPipe initObj;
+
+    /* 创建wakeupfd，用来notify唤醒subReactor处理新来的channel */
+    int createEventfd() {
+        int evtfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (evtfd < 0) {
+            LOG_FATAL("eventfd error:%d\n", errno);
+        }
+        return evtfd;
+    }
+
     EventLoop::EventLoop()
             : looping_(false),
               quit_(false),
+              callingPendingFunctors_(false),
+              wakeupPending_(false),
+              callingBeforeSleep_(false),
               threadId_(std::this_thread::get_id()),
-              poller_(new kvDB::EpollPoller(this)){
+              iteration_(0),
+              busyPollUs_(0),
+              lastActiveUs_(0),
+              spins_(0),
+              spinHits_(0),
+              sleeps_(0),
+              dispatchStartUs_(0),
+              lastLagUs_(0),
+              maxLagUs_(0),
+              totalLagUs_(0),
+              poller_(Poller::newDefaultPoller(this)),
+              timerQueue_(new TimerQueue(this)),
+              wakeupFd_(createEventfd()),
+              wakeupChannel_(new Channel(this, wakeupFd_)),
+              nextBeforeSleepId_(0){
         if (t_loopInThread) {
             LOG_FATAL("Another EventLoop %p existed in this thread.\n", t_loopInThread);
         } else {
             t_loopInThread = this;
         }
+        // 设置wakeupfd的事件类型以及发生事件后的回调操作, 每一个EventLoop都将监听wakeupChannel的EPOLLIN读事件
+        wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleRead, this));
+        wakeupChannel_->enableReading();
     }
 
     EventLoop::~EventLoop() {
         assert(!looping_);
+        wakeupChannel_->disableAll();
+        wakeupChannel_->remove();
+        ::close(wakeupFd_);
         t_loopInThread = nullptr;
     }
 
@@ -52,20 +100,184 @@ namespace kvDB {
         quit_ = false;
 
         while (!quit_) {
+            doBeforeSleep();
             activeChannels_.clear();
-            epollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+            /* 上一次poll返回时还在忙轮询窗口内就不阻塞 */
+            const bool spin = busyPollUs_ > 0 &&
+                              epollReturnTime_.microSecondsSinceEpoch() - lastActiveUs_ < busyPollUs_;
+            dispatchStartUs_.store(0, std::memory_order_relaxed);
+            epollReturnTime_ = poller_->poll(spin ? 0 : kPollTimeMs, &activeChannels_);
+            dispatchStartUs_.store(epollReturnTime_.microSecondsSinceEpoch(), std::memory_order_relaxed);
+            ++iteration_;
+            if (!activeChannels_.empty()) {
+                lastActiveUs_ = epollReturnTime_.microSecondsSinceEpoch();
+            }
+            if (spin) {
+                increase(spins_);
+                if (!activeChannels_.empty()) {
+                    increase(spinHits_);
+                }
+            } else {
+                increase(sleeps_);
+            }
             for (Channel* channel : activeChannels_) {
                 channel->handleEvent(epollReturnTime_);
             }
+            /* 执行当前EventLoop事件循环需要处理的回调操作
+             * mainLoop事先注册一个回调cb(需要subLoop来执行), wakeup subLoop后执行 */
+            doPendingFunctors();
+
+            /* 从poll返回到事件和回调都处理完的时间就是这一轮的延迟 */
+            int64_t lag = Timestamp::now().microSecondsSinceEpoch() - epollReturnTime_.microSecondsSinceEpoch();
+            lastLagUs_.store(lag, std::memory_order_relaxed);
+            if (lag > maxLagUs_.load(std::memory_order_relaxed)) {
+                maxLagUs_.store(lag, std::memory_order_relaxed);
+            }
+            totalLagUs_.store(totalLagUs_.load(std::memory_order_relaxed) + lag, std::memory_order_relaxed);
         }
+        dispatchStartUs_.store(0, std::memory_order_relaxed);
         looping_ = false;
     }
 
-    void EventLoop::runInLoop(const Functor &cb) {
-        cb();
+    void EventLoop::runInLoop(Functor cb) {
+        if (isInLoopThread()) {
+            cb();
+        } else {
+            queueInLoop(std::move(cb));
+        }
+    }
+
+    void EventLoop::queueInLoop(Functor cb) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pendingFunctors_.push_back(std::move(cb));
+        }
+        /* 不在loop线程, 或者loop线程正在执行回调(回调中又投递了新的回调), 都需要唤醒,
+         * 否则新投递的回调要等到下一次epoll_wait返回才能执行. beforeSleep阶段之后马上进入poll, 同样需要唤醒.
+         * 同一批回调只需要写一次eventfd, 其余的投递者看到wakeupPending_已置位就直接返回 */
+        if (!isInLoopThread() || callingPendingFunctors_ || callingBeforeSleep_) {
+            if (!wakeupPending_.exchange(true, std::memory_order_acq_rel)) {
+                wakeup();
+            }
+        }
+    }
+
+    size_t EventLoop::queueSize() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pendingFunctors_.size();
     }
 
-    void EventLoop::quit() { quit_ = true; }
+    void EventLoop::wakeup() {
+        uint64_t one = 1;
+        ssize_t n = ::write(wakeupFd_, &one, sizeof one);
+        if (n != sizeof one) {
+            LOG_ERROR("EventLoop::wakeup() writes %ld bytes instead of 8\n", n);
+        }
+    }
+
+    void EventLoop::handleRead() {
+        uint64_t one = 1;
+        ssize_t n = ::read(wakeupFd_, &one, sizeof one);
+        if (n != sizeof one) {
+            LOG_ERROR("EventLoop::handleRead() reads %ld bytes instead of 8\n", n);
+        }
+    }
+
+    void EventLoop::doPendingFunctors() {
+        callingPendingFunctors_ = true;
+        /* 先清除标志再取队列: 之后投递的回调一定会再次唤醒loop, 不会丢失 */
+        wakeupPending_.store(false, std::memory_order_release);
+
+        /* 交换到runningFunctors_, 缩小临界区, 同时避免回调中再次queueInLoop造成死锁 */
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            runningFunctors_.swap(pendingFunctors_);
+        }
+
+        for (const Functor& functor : runningFunctors_) {
+            functor();
+        }
+        // clear()保留容量, 下一次swap后pendingFunctors_不需要重新分配内存
+        runningFunctors_.clear();
+        callingPendingFunctors_ = false;
+    }
+
+    EventLoop::PollStats EventLoop::pollStats() const {
+        PollStats stats;
+        stats.spins = spins_.load(std::memory_order_relaxed);
+        stats.spinHits = spinHits_.load(std::memory_order_relaxed);
+        stats.sleeps = sleeps_.load(std::memory_order_relaxed);
+        stats.maxLagUs = maxLagUs_.load(std::memory_order_relaxed);
+        stats.totalLagUs = totalLagUs_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    int64_t EventLoop::lagUs() const {
+        int64_t start = dispatchStartUs_.load(std::memory_order_relaxed);
+        if (start == 0) {
+            return 0;
+        }
+        int64_t current = Timestamp::now().microSecondsSinceEpoch() - start;
+        return std::max(current, lastLagUs_.load(std::memory_order_relaxed));
+    }
+
+    int EventLoop::addBeforeSleep(Functor cb) {
+        assertInLoopThread();
+        assert(!callingBeforeSleep_);
+        beforeSleepCallbacks_.emplace_back(nextBeforeSleepId_, std::move(cb));
+        return nextBeforeSleepId_++;
+    }
+
+    void EventLoop::removeBeforeSleep(int id) {
+        assertInLoopThread();
+        assert(!callingBeforeSleep_);
+        beforeSleepCallbacks_.erase(
+                std::remove_if(beforeSleepCallbacks_.begin(), beforeSleepCallbacks_.end(),
+                               [id](const std::pair<int, Functor>& item) { return item.first == id; }),
+                beforeSleepCallbacks_.end());
+    }
+
+    void EventLoop::doBeforeSleep() {
+        callingBeforeSleep_ = true;
+        for (const auto& item : beforeSleepCallbacks_) {
+            item.second();
+        }
+        callingBeforeSleep_ = false;
+    }
+
+    void EventLoop::quit() {
+        quit_ = true;
+        /* 在其他线程中调用quit, 需要唤醒阻塞在epoll_wait上的loop */
+        if (!isInLoopThread()) {
+            wakeup();
+        }
+    }
+
+    TimerId EventLoop::runAt(Timestamp time, TimerCallback cb) {
+        return timerQueue_->addTimer(std::move(cb), time, 0.0);
+    }
+
+    TimerId EventLoop::runAfter(double delay, TimerCallback cb) {
+        Timestamp time(addTime(Timestamp::now(), delay));
+        return runAt(time, std::move(cb));
+    }
+
+    TimerId EventLoop::runEvery(double interval, TimerCallback cb) {
+        Timestamp time(addTime(Timestamp::now(), interval));
+        return timerQueue_->addTimer(std::move(cb), time, interval);
+    }
+
+    void EventLoop::cancel(TimerId timerId) {
+        timerQueue_->cancel(timerId);
+    }
+
+    void EventLoop::handleSignal(int signo, SignalCallback cb) {
+        assertInLoopThread();
+        if (!signalHandler_) {
+            signalHandler_.reset(new SignalHandler(this));
+        }
+        signalHandler_->add(signo, std::move(cb));
+    }
 
     void EventLoop::updateChannel(Channel *channel) {
         assert(channel->ownerLoop() == this);
@@ -79,4 +291,4 @@ namespace kvDB {
         poller_->removeChannel(channel);
     }
 
-}
\ No newline at end of file
+}
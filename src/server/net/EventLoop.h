@@ -15,19 +15,31 @@
 #include <atomic>
 #include <memory>
 #include <functional>
+#include <mutex>
 #include <thread>
 #include <vector>
 #include "../comm/Timestamp.h"
-#include "EpollPoller.h"
-
-class EpollPoller;
-class Channel;
+#include "Callbacks.h"
+#include "Poller.h"
+#include "TimerId.h"
 
 namespace kvDB {
+    class TimerQueue;
+    class SignalHandler;
+
     class EventLoop {
     public:
         using Functor = std::function<void()>;
 
+        /* poll的统计, 可以在任意线程中读取 */
+        struct PollStats {
+            uint64_t spins = 0;      // 忙轮询时0超时的poll次数
+            uint64_t spinHits = 0;   // 其中取到了事件的次数
+            uint64_t sleeps = 0;     // 可能阻塞的poll次数
+            int64_t maxLagUs = 0;    // 单轮从poll返回到处理完事件和回调的最长时间(微秒)
+            int64_t totalLagUs = 0;  // 所有轮次的处理时间之和, 除以spins + sleeps得到平均值
+        };
+
         EventLoop();
         ~EventLoop();
 
@@ -58,7 +70,56 @@ namespace kvDB {
          * 如果用户在同一个loop线程, cb会在该函数内运行; 否则， 会在loop线程中排队运行.
          * 因此, 在其他线程中调用该函数是安全的.
          */
-        void runInLoop(const Functor& cb);
+        void runInLoop(Functor cb);
+
+        /* 把cb放入队列中, 唤醒loop所在的线程, 在本轮事件处理完之后执行cb.
+         * 一次唤醒之后、loop取走队列之前再投递的回调不会重复写eventfd */
+        void queueInLoop(Functor cb);
+
+        /* 注册beforeSleep阶段的回调: 每轮循环在poll阻塞之前按注册顺序执行一次, 返回用于注销的编号.
+         * 一轮事件中积累的工作(合并发送回复、刷新AOF、主动过期等)放在这里统一处理.
+         * 只能在loop线程中调用, 不能在beforeSleep回调中注册或注销 */
+        int addBeforeSleep(Functor cb);
+        void removeBeforeSleep(int id);
+
+        /* 设置忙轮询窗口: 最近一次有事件之后的windowUs微秒内用0超时poll, 线程不睡眠,
+         * 用CPU换掉被唤醒的延迟; 窗口内没有事件时回到阻塞的poll. 0表示关闭(默认), 必须在loop线程中调用 */
+        void setBusyPoll(int64_t windowUs) {
+            assertInLoopThread();
+            busyPollUs_ = windowUs;
+        }
+
+        PollStats pollStats() const;
+
+        /* loop的延迟(微秒): 阻塞在poll中时为0(空闲); 否则是上一轮从poll返回到处理完事件和回调的时间,
+         * 与本轮已经处理的时间中的较大者. 一个耗时的命令(如大的hgetall)执行期间, 其他线程就能看到延迟在增长.
+         * 可以在任意线程中调用 */
+        int64_t lagUs() const;
+
+        /* loop已经循环的次数(epoll_wait返回的次数) */
+        int64_t iteration() const { return iteration_; }
+
+        /* 待执行回调的个数 */
+        size_t queueSize();
+
+        /* 通过eventfd唤醒阻塞在epoll_wait上的loop线程 */
+        void wakeup();
+
+        /* 在time时刻执行cb, 可以在任意线程中调用 */
+        TimerId runAt(Timestamp time, TimerCallback cb);
+
+        /* delay秒后执行cb, 可以在任意线程中调用 */
+        TimerId runAfter(double delay, TimerCallback cb);
+
+        /* 每隔interval秒执行一次cb, 可以在任意线程中调用 */
+        TimerId runEvery(double interval, TimerCallback cb);
+
+        /* 取消定时器, 可以在任意线程中调用 */
+        void cancel(TimerId timerId);
+
+        /* 在loop中处理信号signo: 信号被屏蔽后经signalfd作为普通的读事件送到loop, 回调在loop线程中执行.
+         * 必须在loop线程中、创建其他线程(如subLoop)之前调用, 之后创建的线程继承屏蔽字, 信号只会送到这个loop */
+        void handleSignal(int signo, SignalCallback cb);
 
         void updateChannel(Channel * channel);
         void removeChannel(Channel * channel);
@@ -66,17 +127,57 @@ namespace kvDB {
     private:
         void abortNotInLoopThread();
 
+        /* wakeupFd_可读时的回调, 读掉eventfd的计数 */
+        void handleRead();
+
+        /* 执行其他线程投递过来的回调 */
+        void doPendingFunctors();
+
+        /* 执行beforeSleep阶段的回调 */
+        void doBeforeSleep();
+
+        /* 只由loop线程修改的计数器, 其他线程可以读取 */
+        static void increase(std::atomic<uint64_t>& counter) {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
     private:
         using ChannelList = std::vector<Channel*>;
 
     private:
         std::atomic_bool      looping_;                  // 是否正在循环
         std::atomic_bool      quit_;                     // 是否离开正在循环的线程EventLoop
+        std::atomic_bool      callingPendingFunctors_;   // 是否正在执行pendingFunctors_
+        std::atomic_bool      wakeupPending_;            // 已经写过eventfd, loop还没有取走pendingFunctors_
+        bool                  callingBeforeSleep_;       // 是否正在执行beforeSleep回调, 只在loop线程中访问
         const std::thread::id threadId_;
         Timestamp             epollReturnTime_;          // epoll返回时间
-
-        std::unique_ptr<EpollPoller>  poller_;
+        int64_t               iteration_;                // loop循环的次数
+        int64_t               busyPollUs_;               // 忙轮询窗口(微秒), 0表示关闭
+        int64_t               lastActiveUs_;             // 最近一次poll取到事件的时间
+        std::atomic<uint64_t> spins_;
+        std::atomic<uint64_t> spinHits_;
+        std::atomic<uint64_t> sleeps_;
+        std::atomic<int64_t>  dispatchStartUs_;          // 本轮poll返回的时间, 在poll中时为0
+        std::atomic<int64_t>  lastLagUs_;                // 上一轮的处理时间
+        std::atomic<int64_t>  maxLagUs_;
+        std::atomic<int64_t>  totalLagUs_;
+
+        std::unique_ptr<Poller>       poller_;
         ChannelList                   activeChannels_;   // 活跃的channel -> fd
+        /* 下面两个成员析构时要从poller_中移除自己的channel, 必须在poller_之前析构, 所以声明在poller_之后 */
+        std::unique_ptr<TimerQueue>   timerQueue_;       // 定时器队列
+        std::unique_ptr<SignalHandler> signalHandler_;   // 第一次handleSignal时创建
+
+        int                           wakeupFd_;         // 用于唤醒loop的eventfd
+        std::unique_ptr<Channel>      wakeupChannel_;    // 包装wakeupFd_的channel
+
+        std::mutex                    mutex_;            // 保护pendingFunctors_
+        std::vector<Functor>          pendingFunctors_;  // 其他线程投递的待执行回调
+        std::vector<Functor>          runningFunctors_;  // 与pendingFunctors_交换后在loop线程中执行, 复用两者的内存
+
+        std::vector<std::pair<int, Functor>> beforeSleepCallbacks_;  // beforeSleep阶段的回调和编号
+        int                           nextBeforeSleepId_;
     };
 }
 
@@ -0,0 +1,76 @@
+/**
+  ******************************************************************************
+  * @file           : EventLoopThread.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-8
+  ******************************************************************************
+  */
+
+
+#include "EventLoopThread.h"
+#include "EventLoop.h"
+#include "../comm/Affinity.h"
+#include "../comm/Logger.h"
+#include <cerrno>
+
+namespace kvDB {
+    EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, std::string name, int cpu)
+            : loop_(nullptr),
+              exiting_(false),
+              name_(std::move(name)),
+              cpu_(cpu),
+              callback_(cb) {
+    }
+
+    EventLoopThread::~EventLoopThread() {
+        exiting_ = true;
+        if (loop_ != nullptr) {
+            loop_->quit();
+        }
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    EventLoop* EventLoopThread::startLoop() {
+        thread_ = std::thread(std::bind(&EventLoopThread::threadFunc, this));
+
+        EventLoop* loop = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this] { return loop_ != nullptr; });
+            loop = loop_;
+        }
+        return loop;
+    }
+
+    void EventLoopThread::threadFunc() {
+        /* 先绑定CPU再创建EventLoop，loop和之后在这个线程中分配的内存按first-touch落在本地NUMA节点 */
+        if (cpu_ >= 0) {
+            if (!bindThreadToCpus(std::vector<int>(1, cpu_))) {
+                LOG_ERROR("%s bind to cpu %d failed:%d\n", name_.c_str(), cpu_, errno);
+            } else if (!useLocalNumaMemory()) {
+                LOG_WARN("%s set local numa memory policy failed:%d\n", name_.c_str(), errno);
+            }
+        }
+        /* one loop per thread: EventLoop在新线程中创建, 其生命周期与线程函数相同 */
+        EventLoop loop;
+
+        if (callback_) {
+            callback_(&loop);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            loop_ = &loop;
+            cond_.notify_one();
+        }
+
+        loop.loop();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        loop_ = nullptr;
+    }
+}
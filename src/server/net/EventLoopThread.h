@@ -0,0 +1,54 @@
+/**
+  ******************************************************************************
+  * @file           : EventLoopThread.h
+  * @author         : zgys
+  * @brief          : 绑定一个线程和一个EventLoop，实现one loop per thread
+  * @attention      : None
+  * @date           : 23-4-8
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_EVENTLOOPTHREAD_H
+#define KVDB_EVENTLOOPTHREAD_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "../comm/Noncopyable.h"
+
+namespace kvDB {
+
+    class EventLoop;
+
+    class EventLoopThread : Noncopyable {
+    public:
+        using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+        /* cpu不小于0时，线程在创建EventLoop之前绑定到这个CPU，之后分配的内存(loop、缓冲区等)在它的NUMA节点上 */
+        explicit EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(),
+                                 std::string name = std::string(),
+                                 int cpu = -1);
+        ~EventLoopThread();
+
+        /* 启动线程，在新线程中创建EventLoop并运行loop，等到EventLoop创建完成后返回它的指针 */
+        EventLoop* startLoop();
+
+    private:
+        /* 线程函数，在栈上创建EventLoop并运行loop */
+        void threadFunc();
+
+        EventLoop*              loop_;      // 线程中运行的EventLoop
+        bool                    exiting_;
+        std::thread             thread_;
+        std::string             name_;
+        int                     cpu_;       // 绑定的CPU，-1表示不绑定
+        std::mutex              mutex_;
+        std::condition_variable cond_;      // 等待loop_创建完成
+        ThreadInitCallback      callback_;  // loop运行前在新线程中执行的回调
+    };
+}
+
+#endif //KVDB_EVENTLOOPTHREAD_H
@@ -0,0 +1,80 @@
+/**
+  ******************************************************************************
+  * @file           : EventLoopThreadPool.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-8
+  ******************************************************************************
+  */
+
+
+#include "EventLoopThreadPool.h"
+#include "EventLoopThread.h"
+#include "EventLoop.h"
+#include <cassert>
+
+namespace kvDB {
+    EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseLoop, std::string name)
+            : baseLoop_(baseLoop),
+              name_(std::move(name)),
+              started_(false),
+              numThreads_(0),
+              next_(0) {
+    }
+
+    /* subLoop都是线程栈上的对象，不需要手动delete */
+    EventLoopThreadPool::~EventLoopThreadPool() = default;
+
+    void EventLoopThreadPool::start(const ThreadInitCallback& cb) {
+        assert(!started_);
+        baseLoop_->assertInLoopThread();
+        started_ = true;
+
+        for (int i = 0; i < numThreads_; ++i) {
+            std::string threadName = name_ + std::to_string(i);
+            int cpu = cpus_.empty() ? -1 : cpus_[i % cpus_.size()];
+            auto* t = new EventLoopThread(cb, threadName, cpu);
+            threads_.push_back(std::unique_ptr<EventLoopThread>(t));
+            loops_.push_back(t->startLoop());
+            loopCpus_.push_back(cpu);
+        }
+        // 只有baseLoop一个线程
+        if (numThreads_ == 0 && cb) {
+            cb(baseLoop_);
+        }
+    }
+
+    EventLoop* EventLoopThreadPool::getNextLoop() {
+        baseLoop_->assertInLoopThread();
+        assert(started_);
+        EventLoop* loop = baseLoop_;
+
+        if (!loops_.empty()) {
+            loop = loops_[next_];
+            ++next_;
+            if (next_ >= loops_.size()) {
+                next_ = 0;
+            }
+        }
+        return loop;
+    }
+
+    std::vector<EventLoop*> EventLoopThreadPool::getAllLoops() {
+        baseLoop_->assertInLoopThread();
+        assert(started_);
+        if (loops_.empty()) {
+            return std::vector<EventLoop*>(1, baseLoop_);
+        }
+        return loops_;
+    }
+
+    std::vector<int> EventLoopThreadPool::getLoopCpus() {
+        baseLoop_->assertInLoopThread();
+        assert(started_);
+        if (loopCpus_.empty()) {
+            return std::vector<int>(1, -1);
+        }
+        return loopCpus_;
+    }
+}
@@ -0,0 +1,68 @@
+/**
+  ******************************************************************************
+  * @file           : EventLoopThreadPool.h
+  * @author         : zgys
+  * @brief          : IO线程池，baseLoop负责accept，subLoop负责已建立连接的读写
+  * @attention      : None
+  * @date           : 23-4-8
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_EVENTLOOPTHREADPOOL_H
+#define KVDB_EVENTLOOPTHREADPOOL_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../comm/Noncopyable.h"
+
+namespace kvDB {
+
+    class EventLoop;
+    class EventLoopThread;
+
+    class EventLoopThreadPool : Noncopyable {
+    public:
+        using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+        EventLoopThreadPool(EventLoop* baseLoop, std::string name);
+        ~EventLoopThreadPool();
+
+        /* 设置subLoop线程的数目，为0时所有连接都运行在baseLoop上 */
+        void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+
+        /* 设置subLoop线程绑定的CPU，第i个线程绑定cpus[i % cpus.size()]，为空时不绑定(默认)，必须在start()之前调用 */
+        void setThreadCpus(std::vector<int> cpus) { cpus_ = std::move(cpus); }
+
+        /* 启动numThreads_个EventLoopThread */
+        void start(const ThreadInitCallback& cb = ThreadInitCallback());
+
+        /* 轮询(round-robin)的方式获取下一个subLoop，没有subLoop时返回baseLoop */
+        EventLoop* getNextLoop();
+
+        /* 获取所有的subLoop，没有subLoop时返回baseLoop */
+        std::vector<EventLoop*> getAllLoops();
+
+        /* 与getAllLoops()一一对应的绑定的CPU，没有绑定的为-1 */
+        std::vector<int> getLoopCpus();
+
+        bool started() const { return started_; }
+
+        const std::string& name() const { return name_; }
+
+    private:
+        EventLoop*   baseLoop_;       // 用户创建的loop，负责accept
+        std::string  name_;
+        bool         started_;
+        int          numThreads_;
+        size_t       next_;           // 轮询下一个subLoop的下标
+        std::vector<std::unique_ptr<EventLoopThread>> threads_;
+        std::vector<EventLoop*>                       loops_;
+        std::vector<int>                              cpus_;         // subLoop线程绑定的CPU列表
+        std::vector<int>                              loopCpus_;     // 每个subLoop绑定的CPU
+    };
+}
+
+#endif //KVDB_EVENTLOOPTHREADPOOL_H
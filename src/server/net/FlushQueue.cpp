@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file           : FlushQueue.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-21
+  ******************************************************************************
+  */
+
+
+#include "FlushQueue.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+
+namespace kvDB {
+    FlushQueue::FlushQueue(EventLoop* loop)
+            : loop_(loop),
+              beforeSleepId_(-1) {
+    }
+
+    void FlushQueue::start() {
+        /* beforeSleep回调只持有弱引用，Server析构后回调什么也不做 */
+        std::weak_ptr<FlushQueue> weakQueue(shared_from_this());
+        loop_->runInLoop([weakQueue]() {
+            if (auto queue = weakQueue.lock()) {
+                queue->beforeSleepId_ = queue->loop_->addBeforeSleep([weakQueue]() {
+                    if (auto q = weakQueue.lock()) {
+                        q->flush();
+                    }
+                });
+            }
+        });
+    }
+
+    void FlushQueue::stop() {
+        std::weak_ptr<FlushQueue> weakQueue(shared_from_this());
+        loop_->runInLoop([weakQueue]() {
+            if (auto queue = weakQueue.lock()) {
+                if (queue->beforeSleepId_ >= 0) {
+                    queue->loop_->removeBeforeSleep(queue->beforeSleepId_);
+                    queue->beforeSleepId_ = -1;
+                }
+                queue->pending_.clear();
+            }
+        });
+    }
+
+    void FlushQueue::flush() {
+        if (pending_.empty()) {
+            return;
+        }
+        /* 交换出来再发送，发送过程中新登记的连接留到下一轮 */
+        flushing_.swap(pending_);
+        for (const TcpConnectionPtr& conn : flushing_) {
+            conn->flushOutput();
+        }
+        flushing_.clear();
+    }
+}
@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file           : FlushQueue.h
+  * @author         : zgys
+  * @brief          : 合并一轮事件中产生的回复，每个EventLoop一个
+  * @attention      : 只能在所属loop的线程中使用
+  * @date           : 23-4-21
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_FLUSHQUEUE_H
+#define KVDB_FLUSHQUEUE_H
+
+#include <memory>
+#include <vector>
+#include "../comm/Noncopyable.h"
+#include "Callbacks.h"
+
+namespace kvDB {
+    class EventLoop;
+
+    /* 连接在一轮事件中send的回复先挂到自己的发送链上，连接本身登记到队列里.
+     * 在loop的beforeSleep阶段对每个登记的连接做一次writev，
+     * pipeline的多个命令的回复合并成一次系统调用和尽量少的TCP报文 */
+    class FlushQueue : Noncopyable, public std::enable_shared_from_this<FlushQueue> {
+    public:
+        explicit FlushQueue(EventLoop* loop);
+        ~FlushQueue() = default;
+
+        /* 注册/注销loop的beforeSleep回调，可以在任意线程中调用 */
+        void start();
+        void stop();
+
+        /* 登记有待发送回复的连接，连接自己保证每轮只登记一次 */
+        void add(const TcpConnectionPtr& conn) { pending_.push_back(conn); }
+
+        /* 等待发送的连接数 */
+        size_t size() const { return pending_.size(); }
+
+    private:
+        /* beforeSleep回调，发送所有登记的连接的发送链 */
+        void flush();
+
+        EventLoop* loop_;
+        int beforeSleepId_;
+        std::vector<TcpConnectionPtr> pending_;
+        std::vector<TcpConnectionPtr> flushing_;  // 与pending_交换后发送，复用两者的内存
+    };
+}
+
+#endif //KVDB_FLUSHQUEUE_H
@@ -12,7 +12,6 @@
 #include "InetAddress.h"
 #include <cstring>
 #include <arpa/inet.h>
-#include "InetAddress.h"
 
 namespace kvDB {
 
@@ -24,7 +23,18 @@ namespace kvDB {
         addr_.sin_addr.s_addr = inet_addr(ip.c_str());
     }
 
+    InetAddress InetAddress::fromUnixPath(const std::string& path) {
+        sockaddr_un addr;
+        bzero(&addr, sizeof addr);
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        return InetAddress(addr);
+    }
+
     std::string InetAddress::toIp() const{
+        if (isUnix()) {
+            return addrUn_.sun_path;
+        }
         char buf[64] = {0};
         /* 将IPv4或IPv6 Internet网络地址转换为 Internet标准格式的字符串 */
         ::inet_ntop(AF_INET,&addr_.sin_addr,buf,sizeof buf);
@@ -32,6 +42,9 @@ namespace kvDB {
     }
 
     std::string InetAddress::toIpPort() const{
+        if (isUnix()) {
+            return std::string("unix:") + addrUn_.sun_path;
+        }
         char buf[64] = {0};
         ::inet_ntop(AF_INET,&addr_.sin_addr,buf,sizeof buf);
 
@@ -42,7 +55,17 @@ namespace kvDB {
     }
 
     uint16_t InetAddress::toPort() const{
-        return ntohs(addr_.sin_port);
+        return isUnix() ? 0 : ntohs(addr_.sin_port);
+    }
+
+    const sockaddr* InetAddress::getSockAddrPtr() const {
+        return isUnix() ? reinterpret_cast<const sockaddr*>(&addrUn_) :
+               reinterpret_cast<const sockaddr*>(&addr_);
+    }
+
+    socklen_t InetAddress::getSockLen() const {
+        return isUnix() ? static_cast<socklen_t>(sizeof addrUn_) :
+               static_cast<socklen_t>(sizeof addr_);
     }
 
 }
\ No newline at end of file
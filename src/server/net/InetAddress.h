@@ -15,23 +15,41 @@
 #include <cstdint>
 #include <string>
 #include <netinet/in.h>
+#include <sys/un.h>
 
 namespace kvDB {
 
+    /* IPv4地址或者Unix域套接字的路径 */
     class InetAddress {
     public:
         explicit InetAddress(uint16_t port = 12345, const std::string& ip = "127.0.0.1");
         explicit InetAddress(const sockaddr_in& addr) : addr_(addr) {}
+        explicit InetAddress(const sockaddr_un& addr) : addrUn_(addr) {}
 
+        /* Unix域套接字的地址，路径超过sun_path长度时截断 */
+        static InetAddress fromUnixPath(const std::string& path);
+
+        /* Unix域套接字的地址返回路径(未命名的对端为空)，Port为0 */
         std::string toIp() const;
         std::string toIpPort() const;
         uint16_t toPort() const;
 
+        sa_family_t family() const { return addr_.sin_family; }
+        bool isUnix() const { return family() == AF_UNIX; }
+
         const sockaddr_in &getSockAddr() const { return addr_; }
         void setSockAddr(const sockaddr_in &addr) { addr_ = addr; }
+        void setSockAddr(const sockaddr_un &addr) { addrUn_ = addr; }
+
+        /* 按地址族给出bind/connect使用的地址和长度 */
+        const sockaddr* getSockAddrPtr() const;
+        socklen_t getSockLen() const;
 
     private:
-        sockaddr_in addr_;
+        union {
+            sockaddr_in addr_;
+            sockaddr_un addrUn_;
+        };
     };
 
 }
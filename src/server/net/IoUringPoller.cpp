@@ -0,0 +1,400 @@
+/**
+  ******************************************************************************
+  * @file           : IoUringPoller.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : 直接使用io_uring的系统调用，不依赖liburing
+  * @date           : 23-4-15
+  ******************************************************************************
+  */
+
+
+#include "IoUringPoller.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "../comm/Logger.h"
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/time_types.h>
+#include <unistd.h>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+namespace kvDB {
+    // Channel 未添加到poller中
+    const int kNew = -1;
+    // Channel已经添加到poller中
+    const int kAdded = 1;
+    // Channel不关心任何事件, 已经取消了poll
+    const int kDeleted = 2;
+
+    /* io_uring需要的特性: SQ和CQ一次映射, CQ溢出时不丢事件, io_uring_enter带超时参数 */
+    const unsigned kRequiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG
+                                       | IORING_FEAT_RSRC_TAGS;  // RSRC_TAGS与multishot poll同在5.13加入
+
+    IoUringPoller::IoUringPoller(EventLoop* loop)
+            : Poller(loop),
+              ringFd_(-1),
+              ringPtr_(MAP_FAILED),
+              ringSize_(0),
+              sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+              sqesSize_(0),
+              sqHead_(nullptr),
+              sqTail_(nullptr),
+              sqArray_(nullptr),
+              sqMask_(0),
+              sqEntries_(0),
+              cqHead_(nullptr),
+              cqTail_(nullptr),
+              cqMask_(0),
+              cqes_(nullptr),
+              sqeTail_(0),
+              unsubmitted_(0),
+              nextGeneration_(0),
+              iteration_(0) {
+    }
+
+    IoUringPoller::~IoUringPoller() {
+        if (sqes_ != MAP_FAILED) {
+            ::munmap(sqes_, sqesSize_);
+        }
+        if (ringPtr_ != MAP_FAILED) {
+            ::munmap(ringPtr_, ringSize_);
+        }
+        if (ringFd_ >= 0) {
+            ::close(ringFd_);
+        }
+    }
+
+    bool IoUringPoller::init() {
+        io_uring_params params;
+        memset(&params, 0, sizeof params);
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = kRingEntries * 2;
+
+        ringFd_ = static_cast<int>(::syscall(__NR_io_uring_setup, kRingEntries, &params));
+        if (ringFd_ < 0) {
+            LOG_ERROR("io_uring_setup error:%d\n", errno);
+            return false;
+        }
+        if ((params.features & kRequiredFeatures) != kRequiredFeatures) {
+            LOG_ERROR("io_uring features 0x%x are not enough.\n", params.features);
+            return false;
+        }
+
+        size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        ringSize_ = sqSize > cqSize ? sqSize : cqSize;
+        ringPtr_ = ::mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ringFd_, IORING_OFF_SQ_RING);
+        if (ringPtr_ == MAP_FAILED) {
+            LOG_ERROR("io_uring mmap ring error:%d\n", errno);
+            return false;
+        }
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED) {
+            LOG_ERROR("io_uring mmap sqes error:%d\n", errno);
+            return false;
+        }
+
+        char* ring = static_cast<char*>(ringPtr_);
+        sqHead_    = reinterpret_cast<unsigned*>(ring + params.sq_off.head);
+        sqTail_    = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+        sqArray_   = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+        sqMask_    = *reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+        sqEntries_ = *reinterpret_cast<unsigned*>(ring + params.sq_off.ring_entries);
+        cqHead_    = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+        cqTail_    = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+        cqMask_    = *reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+        cqes_      = reinterpret_cast<io_uring_cqe*>(ring + params.cq_off.cqes);
+        sqeTail_   = *sqTail_;
+
+        LOG_INFO("IoUringPoller created, sq entries = %u.\n", sqEntries_);
+        return true;
+    }
+
+    Timestamp IoUringPoller::poll(int timeoutMs, ChannelList* activeChannels) {
+        submitRetries();
+        /* 重新提交上一轮已经返回的单次poll(水平触发): 如果数据没有读完, 这个poll会立即返回 */
+        for (int fd : rearms_) {
+            Entry* entry = findEntry(fd);
+            if (entry != nullptr && !entry->armed
+                && entry->channel->index() == kAdded && !entry->channel->isNoneEvent()) {
+                arm(fd, *entry);
+            }
+        }
+        rearms_.clear();
+
+        __kernel_timespec ts;
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+        io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof arg);
+        arg.ts = timeoutMs >= 0 ? reinterpret_cast<uint64_t>(&ts) : 0;
+
+        /* 一次系统调用提交本轮所有的SQE并等待事件; removeChannel中已经取出的事件不用再等待 */
+        int ret = enter(events_.empty() ? 1 : 0, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+        int savedErrno = errno;
+        Timestamp now(Timestamp::now());
+        ++iteration_;
+
+        reap();
+        for (const Event& event : events_) {
+            Entry* entry = findEntry(event.fd);
+            // 取出事件之后channel被删除或者poll被替换
+            if (entry == nullptr || entry->generation != event.generation) {
+                continue;
+            }
+            Channel* channel = entry->channel;
+            if (entry->lastIteration == iteration_) {
+                channel->set_revents(channel->revents() | event.revents);
+            } else {
+                entry->lastIteration = iteration_;
+                channel->set_revents(event.revents);
+                activeChannels->push_back(channel);
+            }
+        }
+        events_.clear();
+        if (ret < 0 && savedErrno != ETIME && savedErrno != EINTR) {
+            LOG_ERROR("IoUringPoller::poll() error:%d\n", savedErrno);
+        }
+        return now;
+    }
+
+    void IoUringPoller::reap() {
+        unsigned head = *cqHead_;
+        unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe* cqe = &cqes_[head & cqMask_];
+            const uint64_t userData = cqe->user_data;
+            const int fd = static_cast<int>(userData >> 32);
+            const auto low = static_cast<uint32_t>(userData);
+            const uint32_t generation = low & kGenerationMask;
+
+            if (low & kTagRemove) {
+                /* -EALREADY: poll正在返回事件; -ENOENT: poll暂时不在取消表中(可能正在重新注册).
+                 * 只要还没有收到poll的最后一个CQE，它就可能仍然存活，需要重试 */
+                const uint64_t target = userData & ~static_cast<uint64_t>(kTagRemove);
+                if ((cqe->res == -EALREADY || cqe->res == -ENOENT) && cancelling_.count(target) > 0) {
+                    retries_.push_back(userData);
+                } else if (cqe->res < 0 && cqe->res != -EALREADY && cqe->res != -ENOENT) {
+                    LOG_ERROR("io_uring poll remove fd = %d error:%d\n", fd, -cqe->res);
+                }
+                continue;
+            }
+            if (low & kTagUpdate) {
+                // 修改失败时poll还在用旧的事件, 下一轮按channel当前的事件重试
+                Entry* entry = findEntry(fd);
+                if ((cqe->res == -EALREADY || cqe->res == -ENOENT)
+                    && entry != nullptr && entry->armed && entry->generation == generation) {
+                    retries_.push_back(userData);
+                } else if (cqe->res < 0 && cqe->res != -EALREADY && cqe->res != -ENOENT) {
+                    LOG_ERROR("io_uring poll update fd = %d error:%d\n", fd, -cqe->res);
+                }
+                continue;
+            }
+
+            const bool last = !(cqe->flags & IORING_CQE_F_MORE);
+            if (last && cancelling_.erase(userData) > 0) {
+                // 已经取消的poll结束了, 不再引用fd
+                --channels_[fd].cancelling;
+                continue;
+            }
+            Entry* entry = findEntry(fd);
+            // 已经被取消或替换的poll
+            if (entry == nullptr || !entry->armed || entry->generation != generation) {
+                continue;
+            }
+            if (last) {
+                entry->armed = false;
+                rearms_.push_back(fd);
+            }
+            if (cqe->res > 0) {
+                events_.push_back(Event{fd, generation, cqe->res});
+            }
+        }
+        __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+    }
+
+    void IoUringPoller::updateChannel(Channel* channel) {
+        assertInLoopThread();
+        const int index = channel->index();
+        const int fd = channel->fd();
+        if (index == kNew || index == kDeleted) {
+            if (index == kNew) {
+                if (findEntry(fd) != nullptr) {
+                    LOG_ERROR("fd = %d must not exist in channels_.", fd);
+                    return;
+                }
+                if (static_cast<size_t>(fd) >= channels_.size()) {
+                    channels_.resize(std::max(static_cast<size_t>(fd) + 1, channels_.size() * 2),
+                                     Entry{nullptr, 0, false, -1, 0});
+                }
+                // cancelling保留: removeChannel之后它一定是0
+                channels_[fd].channel = channel;
+                channels_[fd].armed = false;
+                channels_[fd].lastIteration = -1;
+            }
+            channel->set_index(kAdded);
+            Entry& entry = channels_[fd];
+            if (!entry.armed) {
+                arm(fd, entry);
+            }
+        } else {
+            Entry* found = findEntry(fd);
+            if (found == nullptr || found->channel != channel || index != kAdded) {
+                LOG_ERROR("current channel is not matched current fd, fd = %d, channel = 0x%p", fd, channel);
+                return;
+            }
+            Entry& entry = *found;
+            if (channel->isNoneEvent()) {
+                if (entry.armed) {
+                    disarm(fd, entry);
+                }
+                channel->set_index(kDeleted);
+            } else if (entry.armed) {
+                // 关心的事件变了, 原地修改poll; 没有armed时会在下一次poll中按新的事件重新提交
+                submitUpdate(fd, entry);
+            }
+        }
+    }
+
+    void IoUringPoller::removeChannel(Channel* channel) {
+        assertInLoopThread();
+        const int fd = channel->fd();
+        Entry* entry = findEntry(fd);
+        assert(entry != nullptr);
+        assert(entry->channel == channel);
+        assert(channel->isNoneEvent());
+
+        if (entry->armed) {
+            disarm(fd, *entry);
+        }
+        /* 等待fd上所有被取消的poll结束, 否则poll持有的文件引用会让close(fd)之后socket仍然不释放.
+         * 期间取出的其他channel的事件保存在events_中, 下一次poll时交出 */
+        __kernel_timespec ts;
+        ts.tv_sec = 0;
+        ts.tv_nsec = 10 * 1000 * 1000;
+        io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof arg);
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        while (entry->cancelling > 0) {
+            submitRetries();
+            enter(1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+            reap();
+        }
+        entry->channel = nullptr;
+        entry->armed = false;
+        channel->set_index(kNew);
+    }
+
+    io_uring_sqe* IoUringPoller::getSqe() {
+        unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+        if (sqeTail_ - head >= sqEntries_) {
+            // SQ满了, 先提交已有的SQE
+            enter(0, 0, nullptr, 0);
+            head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+            if (sqeTail_ - head >= sqEntries_) {
+                LOG_FATAL("io_uring submission queue is full.\n");
+            }
+        }
+        unsigned idx = sqeTail_ & sqMask_;
+        io_uring_sqe* sqe = &sqes_[idx];
+        memset(sqe, 0, sizeof *sqe);
+        sqArray_[idx] = idx;
+        ++sqeTail_;
+        ++unsubmitted_;
+        return sqe;
+    }
+
+    void IoUringPoller::arm(int fd, Entry& entry) {
+        nextGeneration_ = (nextGeneration_ + 1) & kGenerationMask;
+        entry.generation = nextGeneration_;
+        entry.armed = true;
+
+        io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        // poll的事件与epoll的事件值相同, EPOLLET不是poll的事件, 边沿触发用multishot代替
+        auto events = static_cast<uint32_t>(entry.channel->events()) & ~static_cast<uint32_t>(EPOLLET);
+#if __BYTE_ORDER == __BIG_ENDIAN
+        events = __swahw32(events);
+#endif
+        sqe->poll32_events = events;
+        if (entry.channel->isEdgeTriggered()) {
+            sqe->len = IORING_POLL_ADD_MULTI;
+        }
+        sqe->user_data = encode(fd, entry.generation);
+    }
+
+    void IoUringPoller::disarm(int fd, Entry& entry) {
+        entry.armed = false;
+        const uint64_t target = encode(fd, entry.generation);
+        cancelling_.insert(target);
+        ++entry.cancelling;
+        submitRemove(target);
+    }
+
+    void IoUringPoller::submitRemove(uint64_t target) {
+        io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = target;
+        sqe->user_data = target | kTagRemove;
+    }
+
+    void IoUringPoller::submitUpdate(int fd, const Entry& entry) {
+        io_uring_sqe* sqe = getSqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = encode(fd, entry.generation);
+        // 不带IORING_POLL_ADD_MULTI时修改后的poll会变成单次的
+        sqe->len = IORING_POLL_UPDATE_EVENTS;
+        if (entry.channel->isEdgeTriggered()) {
+            sqe->len |= IORING_POLL_ADD_MULTI;
+        }
+        auto events = static_cast<uint32_t>(entry.channel->events()) & ~static_cast<uint32_t>(EPOLLET);
+#if __BYTE_ORDER == __BIG_ENDIAN
+        events = __swahw32(events);
+#endif
+        sqe->poll32_events = events;
+        sqe->user_data = encode(fd, entry.generation | kTagUpdate);
+    }
+
+    void IoUringPoller::submitRetries() {
+        if (retries_.empty()) {
+            return;
+        }
+        std::vector<uint64_t> retries;
+        retries.swap(retries_);
+        for (uint64_t userData : retries) {
+            const auto low = static_cast<uint32_t>(userData);
+            if (low & kTagRemove) {
+                const uint64_t target = userData & ~static_cast<uint64_t>(kTagRemove);
+                if (cancelling_.count(target) > 0) {
+                    submitRemove(target);
+                }
+            } else {
+                const int fd = static_cast<int>(userData >> 32);
+                Entry* entry = findEntry(fd);
+                if (entry != nullptr && entry->armed && entry->generation == (low & kGenerationMask)) {
+                    submitUpdate(fd, *entry);
+                }
+            }
+        }
+    }
+
+    int IoUringPoller::enter(unsigned minComplete, unsigned flags, void* arg, size_t argSize) {
+        __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+        int ret = static_cast<int>(::syscall(__NR_io_uring_enter, ringFd_, unsubmitted_, minComplete,
+                                             flags, arg, argSize));
+        if (ret > 0) {
+            unsubmitted_ -= static_cast<unsigned>(ret);
+        }
+        return ret;
+    }
+}
@@ -0,0 +1,132 @@
+/**
+  ******************************************************************************
+  * @file           : IoUringPoller.h
+  * @author         : zgys
+  * @brief          : 基于io_uring的Poller，用IORING_OP_POLL_ADD代替epoll_ctl，
+  *                   一轮循环中所有channel的注册、修改、删除和等待事件在一次io_uring_enter中提交
+  * @attention      : 水平触发的channel使用单次poll，事件返回后在下一次poll时重新提交，语义与epoll的LT相同；
+  *                   边沿触发的channel使用multishot poll，只在有新事件时返回
+  * @date           : 23-4-15
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_IOURINGPOLLER_H
+#define KVDB_IOURINGPOLLER_H
+
+#include <vector>
+#include <unordered_set>
+#include <linux/io_uring.h>
+#include "Poller.h"
+
+namespace kvDB {
+    class IoUringPoller : public Poller {
+    public:
+        explicit IoUringPoller(EventLoop* loop);
+        ~IoUringPoller() override;
+
+        /* 创建并映射io_uring，内核不支持时返回false */
+        bool init();
+
+        /* 提交积累的SQE并等待至少一个CQE，将就绪的channel加入activeChannels */
+        Timestamp poll(int timeoutMs, ChannelList* activeChannels) override;
+
+        /* 更新channel关心的事件，只生成SQE，在下一次poll时一起提交 */
+        void updateChannel(Channel* channel) override;
+
+        /* 从Poller中删除channel，只有channel中的fd不监听任何事件才可以移除.
+         * 等到fd上所有的poll都已经结束才返回，之后关闭fd会立即释放socket */
+        void removeChannel(Channel* channel) override;
+
+    private:
+        static const unsigned kRingEntries = 4096;
+
+        /* 每个fd对应的channel和它当前提交的poll */
+        struct Entry {
+            Channel* channel;
+            uint32_t generation;     // 当前poll的代数，用于丢弃已经取消的poll返回的CQE
+            bool     armed;          // poll是否还在内核中等待
+            int64_t  lastIteration;  // 上一次加入activeChannels的轮次，同一轮的多个CQE合并
+            uint32_t cancelling;     // 这个fd上已经取消、但还没有返回最后一个CQE的poll数
+        };
+        /* 以fd为下标的表，没有channel的fd其channel为nullptr */
+        using ChannelMap = std::vector<Entry>;
+
+        /* 已经取出、还没有交给EventLoop的事件，交出时按generation检查poll是否仍然有效 */
+        struct Event {
+            int      fd;
+            uint32_t generation;
+            int      revents;
+        };
+
+        /* user_data的低32位: 最高两位区分poll本身和对它的删除、修改，其余是代数 */
+        static const uint32_t kTagRemove = 1u << 31;
+        static const uint32_t kTagUpdate = 1u << 30;
+        static const uint32_t kGenerationMask = kTagUpdate - 1;
+
+        /* fd对应的Entry，不存在时返回nullptr */
+        Entry* findEntry(int fd) {
+            if (static_cast<size_t>(fd) >= channels_.size() || channels_[fd].channel == nullptr) {
+                return nullptr;
+            }
+            return &channels_[fd];
+        }
+
+        /* 获取一个空闲的SQE，SQ满时先提交已有的SQE */
+        io_uring_sqe* getSqe();
+
+        /* 为fd提交一个关心events的poll */
+        void arm(int fd, Entry& entry);
+
+        /* 取消fd当前的poll，poll返回最后一个CQE(-ECANCELED)之前它仍然持有fd对应的文件 */
+        void disarm(int fd, Entry& entry);
+
+        /* 提交删除user_data为target的poll的请求 */
+        void submitRemove(uint64_t target);
+
+        /* 原地修改fd当前的poll关心的事件(IORING_POLL_UPDATE_EVENTS)，poll正在返回事件时会失败并重试 */
+        void submitUpdate(int fd, const Entry& entry);
+
+        /* 重新提交上一轮返回-EALREADY/-ENOENT、目标poll仍然存活的删除和修改请求 */
+        void submitRetries();
+
+        /* 调用io_uring_enter，提交未提交的SQE */
+        int enter(unsigned minComplete, unsigned flags, void* arg, size_t argSize);
+
+        /* 取出所有CQE，更新poll的状态，就绪的事件放入events_ */
+        void reap();
+
+        static uint64_t encode(int fd, uint32_t generation) {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(fd)) << 32) | generation;
+        }
+
+        int          ringFd_;
+        void*        ringPtr_;       // SQ和CQ共用的映射区
+        size_t       ringSize_;
+        io_uring_sqe* sqes_;
+        size_t       sqesSize_;
+
+        unsigned*    sqHead_;
+        unsigned*    sqTail_;
+        unsigned*    sqArray_;
+        unsigned     sqMask_;
+        unsigned     sqEntries_;
+        unsigned*    cqHead_;
+        unsigned*    cqTail_;
+        unsigned     cqMask_;
+        io_uring_cqe* cqes_;
+
+        unsigned     sqeTail_;       // 本地的SQ尾部，提交时写回sqTail_
+        unsigned     unsubmitted_;   // 还没有提交给内核的SQE个数
+        uint32_t     nextGeneration_;
+        int64_t      iteration_;
+
+        ChannelMap       channels_;
+        std::vector<int> rearms_;    // 单次poll已经返回，等待重新提交的fd
+        std::vector<Event> events_;
+        std::unordered_set<uint64_t> cancelling_;   // 已经取消、还没有返回最后一个CQE的poll的user_data
+        std::vector<uint64_t> retries_;             // 需要重新提交的删除和修改请求的user_data
+    };
+}
+
+#endif //KVDB_IOURINGPOLLER_H
@@ -0,0 +1,140 @@
+/**
+  ******************************************************************************
+  * @file           : OutputChain.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-16
+  ******************************************************************************
+  */
+
+
+#include "OutputChain.h"
+#include <climits>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <algorithm>
+
+namespace kvDB {
+
+    bool Slice::tryAppend(const char* data, size_t len) {
+        if (kind_ != kOwned || owned_.size() + len > OutputChain::kMaxCoalesced) {
+            return false;
+        }
+        owned_.append(data, len);
+        size_ += len;
+        return true;
+    }
+
+    void OutputChain::append(Slice&& slice) {
+        const size_t len = slice.size();
+        if (len == 0) {
+            return;
+        }
+        if (len >= kCoalesceSize || slices_.empty() || !slices_.back().tryAppend(slice.data(), len)) {
+            slices_.push_back(std::move(slice));
+        }
+        bytes_ += len;
+    }
+
+    void OutputChain::append(OutputChain&& other) {
+        for (auto& slice : other.slices_) {
+            append(std::move(slice));
+        }
+        other.slices_.clear();
+        other.bytes_ = 0;
+    }
+
+    void OutputChain::retrieve(size_t len) {
+        assert(len <= bytes_);
+        bytes_ -= len;
+        while (len > 0) {
+            Slice& front = slices_.front();
+            if (len < front.size()) {
+                front.retrieve(len);
+                return;
+            }
+            len -= front.size();
+            slices_.pop_front();
+        }
+    }
+
+    void OutputChain::retrieveAll() {
+        slices_.clear();
+        bytes_ = 0;
+    }
+
+    ssize_t OutputChain::writeFd(int fd, int* savedErrno) {
+        struct iovec vec[IOV_MAX];
+        ssize_t total = 0;
+        while (!slices_.empty()) {
+            Slice& front = slices_.front();
+            if (useZeroCopy(front)) {
+                const ssize_t n = ::send(fd, front.data(), front.size(), MSG_ZEROCOPY);
+                if (n < 0 && errno == ENOBUFS) {
+                    // 超过了optmem的限制，这个连接退回到普通的拷贝发送
+                    zeroCopyThreshold_ = 0;
+                    continue;
+                }
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    *savedErrno = errno;
+                    return total > 0 ? total : -1;
+                }
+                /* 内核为每次成功的MSG_ZEROCOPY发送分配一个递增的序号, 完成之前数据必须保持有效 */
+                pinned_.emplace_back(zeroCopySeq_++, front.shared());
+                const size_t expected = front.size();
+                retrieve(static_cast<size_t>(n));
+                total += n;
+                if (static_cast<size_t>(n) < expected) {
+                    break;
+                }
+                continue;
+            }
+
+            int count = 0;
+            size_t expected = 0;
+            for (auto it = slices_.begin(); it != slices_.end() && count < IOV_MAX; ++it, ++count) {
+                if (count > 0 && useZeroCopy(*it)) {
+                    break;
+                }
+                vec[count].iov_base = const_cast<char*>(it->data());
+                vec[count].iov_len = it->size();
+                expected += it->size();
+            }
+
+            const ssize_t n = count == 1 ? ::write(fd, vec[0].iov_base, vec[0].iov_len)
+                                         : ::writev(fd, vec, count);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                *savedErrno = errno;
+                return total > 0 ? total : -1;
+            }
+            retrieve(static_cast<size_t>(n));
+            total += n;
+            if (static_cast<size_t>(n) < expected) {
+                // 内核发送缓冲区已满
+                break;
+            }
+        }
+        return total;
+    }
+
+    void OutputChain::onZeroCopyCompleted(uint32_t lo, uint32_t hi) {
+        /* 序号是32位循环计数, 用无符号减法判断是否在[lo, hi]内 */
+        auto completed = [lo, hi](const PinnedList::value_type& item) {
+            return item.first - lo <= hi - lo;
+        };
+        // 通知一般按顺序到达
+        while (!pinned_.empty() && completed(pinned_.front())) {
+            pinned_.pop_front();
+        }
+        pinned_.erase(std::remove_if(pinned_.begin(), pinned_.end(), completed), pinned_.end());
+    }
+}
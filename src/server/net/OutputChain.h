@@ -0,0 +1,144 @@
+/**
+  ******************************************************************************
+  * @file           : OutputChain.h
+  * @author         : zgys
+  * @brief          : 发送缓冲区，由引用计数的数据片组成的链，用writev一次发送多个数据片
+  * @attention      : 数据片只读，进入链之后不会被拷贝到连续的内存中
+  * @date           : 23-4-16
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_OUTPUTCHAIN_H
+#define KVDB_OUTPUTCHAIN_H
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <cassert>
+#include <cstdint>
+#include <sys/types.h>
+
+namespace kvDB {
+
+    /* 一段只读的待发送数据，有三种来源:
+     * kOwned  : 移动进来的std::string，由数据片自己持有
+     * kStatic : 生命周期贯穿整个程序的静态数据，只保存指针
+     * kShared : 与其他对象共享的值(如数据库中的value)，持有shared_ptr保证发送完之前不被释放 */
+    class Slice {
+    public:
+        enum Kind { kOwned, kStatic, kShared };
+
+        explicit Slice(std::string str)
+                : kind_(kOwned), owned_(std::move(str)), static_(nullptr), offset_(0), size_(owned_.size()) {}
+
+        explicit Slice(std::shared_ptr<const std::string> str)
+                : kind_(kShared), shared_(std::move(str)), static_(nullptr), offset_(0), size_(shared_->size()) {}
+
+        /* 静态数据，调用者保证data在整个程序运行期间有效 */
+        static Slice fromStatic(const char* data, size_t len) {
+            Slice slice;
+            slice.kind_ = kStatic;
+            slice.static_ = data;
+            slice.size_ = len;
+            return slice;
+        }
+
+        Kind kind() const { return kind_; }
+        /* 未发送数据的首地址，owned_移动后地址会变(SSO)，所以每次都重新计算 */
+        const char* data() const { return base() + offset_; }
+        /* 未发送数据的长度 */
+        size_t size() const { return size_; }
+
+        /* 丢弃前len字节(已经发送) */
+        void retrieve(size_t len) {
+            assert(len <= size_);
+            offset_ += len;
+            size_ -= len;
+        }
+
+        /* 共享数据片持有的数据，其他类型返回空 */
+        const std::shared_ptr<const std::string>& shared() const { return shared_; }
+
+        /* 小数据直接追加到自己持有的string后面，避免链过长 */
+        bool tryAppend(const char* data, size_t len);
+
+    private:
+        Slice() : kind_(kStatic), static_(nullptr), offset_(0), size_(0) {}
+
+        const char* base() const {
+            switch (kind_) {
+                case kOwned:  return owned_.data();
+                case kShared: return shared_->data();
+                default:      return static_;
+            }
+        }
+
+        Kind kind_;
+        std::string owned_;
+        std::shared_ptr<const std::string> shared_;
+        const char* static_;
+        size_t offset_;
+        size_t size_;
+    };
+
+    class OutputChain {
+    public:
+        /* 小于kCoalesceSize的数据片合并到前一个自己持有的数据片中，合并后的数据片最大为kMaxCoalesced */
+        static const size_t kCoalesceSize = 256;
+        static const size_t kMaxCoalesced = 16 * 1024;
+
+        OutputChain() : bytes_(0), zeroCopyThreshold_(0), zeroCopySeq_(0) {}
+
+        /* 链中待发送的字节数 */
+        size_t readableBytes() const { return bytes_; }
+        bool empty() const { return bytes_ == 0; }
+        /* 链中数据片的个数 */
+        size_t sliceCount() const { return slices_.size(); }
+
+        void append(Slice&& slice);
+        void append(std::string&& str) { append(Slice(std::move(str))); }
+        void append(const char* data, size_t len) { append(Slice(std::string(data, len))); }
+        void append(std::shared_ptr<const std::string> str) { append(Slice(std::move(str))); }
+        void appendStatic(const char* data, size_t len) { append(Slice::fromStatic(data, len)); }
+        /* 把other中的数据片全部移动到链尾 */
+        void append(OutputChain&& other);
+
+        /* 丢弃前len字节(已经发送) */
+        void retrieve(size_t len);
+        void retrieveAll();
+
+        /* 用writev发送，每次最多IOV_MAX个数据片，一直写到链为空或者内核发送缓冲区满.
+         * 不小于零拷贝阈值的共享数据片单独用MSG_ZEROCOPY发送.
+         * 返回发送的字节数，一个字节也没有发送且出错时返回-1，错误码保存在savedErrno */
+        ssize_t writeFd(int fd, int* savedErrno);
+
+        /* 设置零拷贝阈值，0表示不使用零拷贝；socket必须已经设置了SO_ZEROCOPY */
+        void setZeroCopyThreshold(size_t threshold) { zeroCopyThreshold_ = threshold; }
+        size_t zeroCopyThreshold() const { return zeroCopyThreshold_; }
+
+        /* 是否用MSG_ZEROCOPY发送这个数据片 */
+        bool useZeroCopy(const Slice& slice) const {
+            return zeroCopyThreshold_ > 0 && slice.kind() == Slice::kShared && slice.size() >= zeroCopyThreshold_;
+        }
+
+        /* 内核通知序号为lo~hi的零拷贝发送已经完成，不再引用对应的数据 */
+        void onZeroCopyCompleted(uint32_t lo, uint32_t hi);
+        /* 内核还在引用的零拷贝发送数 */
+        size_t pinnedCount() const { return pinned_.size(); }
+        /* 连接关闭后不会再收到完成通知，释放所有引用 */
+        void releasePinned() { pinned_.clear(); }
+
+    private:
+        /* 零拷贝发送的数据在完成通知到达之前由这里持有: first-->发送的序号 second-->数据 */
+        using PinnedList = std::deque<std::pair<uint32_t, std::shared_ptr<const std::string>>>;
+
+        std::deque<Slice> slices_;
+        size_t bytes_;
+        size_t zeroCopyThreshold_;
+        uint32_t zeroCopySeq_;   // 下一次零拷贝发送的序号，与内核为每个socket维护的计数一致
+        PinnedList pinned_;
+    };
+}
+
+#endif //KVDB_OUTPUTCHAIN_H
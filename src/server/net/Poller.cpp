@@ -0,0 +1,21 @@
+/**
+  ******************************************************************************
+  * @file           : Poller.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-15
+  ******************************************************************************
+  */
+
+
+#include "Poller.h"
+#include "EventLoop.h"
+
+namespace kvDB {
+    Poller::Backend Poller::s_defaultBackend_ = Poller::kEpoll;
+
+    void Poller::assertInLoopThread() {
+        ownerLoop_->assertInLoopThread();
+    }
+}
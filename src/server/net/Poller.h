@@ -0,0 +1,64 @@
+/**
+  ******************************************************************************
+  * @file           : Poller.h
+  * @author         : zgys
+  * @brief          : IO复用的抽象接口，EventLoop通过它注册channel、等待事件，
+  *                   具体实现有EpollPoller和IoUringPoller
+  * @attention      : None
+  * @date           : 23-4-15
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_POLLER_H
+#define KVDB_POLLER_H
+
+#include <vector>
+#include "../comm/Noncopyable.h"
+#include "../comm/Timestamp.h"
+
+namespace kvDB {
+
+    class Channel;
+    class EventLoop;
+
+    class Poller : Noncopyable {
+    public:
+        using ChannelList = std::vector<Channel*>;
+
+        /* IO复用的后端 */
+        enum Backend {
+            kEpoll,       // epoll(默认)
+            kIoUring,     // io_uring，内核不支持时退回到epoll
+        };
+
+        explicit Poller(EventLoop* loop) : ownerLoop_(loop) {}
+        virtual ~Poller() = default;
+
+        /* 等待事件，将就绪的channel放入activeChannels，返回等待返回的时间 */
+        virtual Timestamp poll(int timeoutMs, ChannelList* activeChannels) = 0;
+
+        /* 更新channel关心的事件 */
+        virtual void updateChannel(Channel* channel) = 0;
+
+        /* 从Poller中删除channel，只有channel中的fd不监听任何事件才可以移除 */
+        virtual void removeChannel(Channel* channel) = 0;
+
+        /* 断言是否在循环的线程中 */
+        void assertInLoopThread();
+
+        /* 按setDefaultBackend设置的后端创建Poller */
+        static Poller* newDefaultPoller(EventLoop* loop);
+
+        /* 设置之后创建的EventLoop使用的后端，必须在创建EventLoop之前调用 */
+        static void setDefaultBackend(Backend backend) { s_defaultBackend_ = backend; }
+
+    protected:
+        EventLoop* ownerLoop_;
+
+    private:
+        static Backend s_defaultBackend_;
+    };
+}
+
+#endif //KVDB_POLLER_H
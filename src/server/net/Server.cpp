@@ -12,14 +12,32 @@
 #include "Server.h"
 #include "../comm/Logger.h"
 #include <memory>
+#include <cassert>
+#include <algorithm>
+#include <sys/stat.h>
 
 namespace kvDB {
     Server::Server(EventLoop* loop, const InetAddress& listenAddr, std::string name)
             : loop_(loop),
               name_(std::move(name)),
               acceptor_(new Acceptor(loop, listenAddr)),
+              threadPool_(new EventLoopThreadPool(loop, name_)),
               connectionCallback_(defaultConnectionCallback),
               messageCallback_(defaultMessageCallback),
+              loadBalance_(kRoundRobin),
+              edgeTriggered_(false),
+              highWaterMark_(0),
+              lowWaterMark_(0),
+              outputLimit_(0),
+              idleTimeout_(0.0),
+              zeroCopyThreshold_(0),
+              coalesceReplies_(true),
+              busyPollUs_(0),
+              socketBusyPollUs_(0),
+              acceptBudget_(64),
+              listenBacklog_(1024),
+              deferAccept_(0),
+              lagThresholdUs_(0),
               started_(false),
               nextConnId_(1){
 
@@ -31,53 +49,223 @@ namespace kvDB {
     }
 
     Server::~Server() {
+        loop_->assertInLoopThread();
+        for (auto& item : loops_) {
+            if (item.second.idleWheel) {
+                item.second.idleWheel->stop();
+            }
+            if (item.second.flushQueue) {
+                item.second.flushQueue->stop();
+            }
+        }
+        /* 连接可能属于其他subLoop，在它所属的loop中销毁 */
+        for (auto& item : connections_) {
+            if (!item) {
+                continue;
+            }
+            TcpConnectionPtr conn(item);
+            item.reset();
+            conn->getLoop()->runInLoop(
+                    std::bind(&TcpConnection::connectDestroyed, conn));
+        }
         LOG_INFO("Server closed......\n");
     }
 
+    void Server::setThreadNum(int numThreads) {
+        assert(0 <= numThreads);
+        threadPool_->setThreadNum(numThreads);
+    }
+
+    void Server::setThreadCpus(std::vector<int> cpus) {
+        threadPool_->setThreadCpus(std::move(cpus));
+    }
+
+    void Server::setEdgeTriggered(bool on) {
+        assert(!started_);
+        edgeTriggered_ = on;
+        acceptor_->setEdgeTriggered(on);
+        if (unixAcceptor_) {
+            unixAcceptor_->setEdgeTriggered(on);
+        }
+    }
+
+    void Server::listenUnix(const std::string& path, mode_t perm) {
+        assert(!started_);
+        unixAcceptor_.reset(new Acceptor(loop_, InetAddress::fromUnixPath(path)));
+        if (perm != 0 && ::chmod(path.c_str(), perm) < 0) {
+            LOG_ERROR("chmod %s fail:%d\n", path.c_str(), errno);
+        }
+        unixAcceptor_->setEdgeTriggered(edgeTriggered_);
+        unixAcceptor_->setNewConnectionCallback(
+                std::bind(&Server::newConnection, this,
+                          std::placeholders::_1,
+                          std::placeholders::_2));
+    }
+
     void Server::start() {
         if (!started_) {
             started_ = true;
+            threadPool_->start(threadInitCallback_);
+            ioLoops_ = threadPool_->getAllLoops();
+            std::vector<int> cpus = threadPool_->getLoopCpus();
+            for (size_t i = 0; i < ioLoops_.size(); ++i) {
+                if (cpus[i] >= 0) {
+                    if (static_cast<size_t>(cpus[i]) >= cpuLoops_.size()) {
+                        cpuLoops_.resize(cpus[i] + 1, nullptr);
+                    }
+                    /* 多个subLoop绑定同一个CPU时取第一个 */
+                    if (cpuLoops_[cpus[i]] == nullptr) {
+                        cpuLoops_[cpus[i]] = ioLoops_[i];
+                    }
+                }
+            }
+            for (EventLoop* ioLoop : ioLoops_) {
+                if (busyPollUs_ > 0) {
+                    ioLoop->runInLoop([ioLoop, windowUs = busyPollUs_]() { ioLoop->setBusyPoll(windowUs); });
+                }
+                LoopContext& context = loops_[ioLoop];
+                context.pool = std::make_shared<ConnectionPool>(ioLoop);
+                if (idleTimeout_ > 0.0) {
+                    context.idleWheel = std::make_shared<TimingWheel>(ioLoop, idleTimeout_);
+                    context.idleWheel->start();
+                }
+                if (coalesceReplies_) {
+                    context.flushQueue = std::make_shared<FlushQueue>(ioLoop);
+                    context.flushQueue->start();
+                }
+            }
         }
-        if (!acceptor_->listening()) {
-            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        for (Acceptor* acceptor : {acceptor_.get(), unixAcceptor_.get()}) {
+            if (acceptor && !acceptor->listening()) {
+                acceptor->setAcceptBudget(acceptBudget_);
+                acceptor->setBacklog(listenBacklog_);
+                acceptor->setDeferAccept(deferAccept_);
+                acceptor->setAdmissionCallback([this]() { return !overloaded(); });
+                loop_->runInLoop(std::bind(&Acceptor::listen, acceptor));
+            }
         }
         LOG_INFO("Server started......\n");
     }
 
-    void Server::newConnection(int sockfd, const InetAddress& peerAddr) {
+    EventLoop::PollStats Server::pollStats() const {
+        EventLoop::PollStats total;
+        for (EventLoop* ioLoop : ioLoops_) {
+            EventLoop::PollStats stats = ioLoop->pollStats();
+            total.spins += stats.spins;
+            total.spinHits += stats.spinHits;
+            total.sleeps += stats.sleeps;
+            total.maxLagUs = std::max(total.maxLagUs, stats.maxLagUs);
+            total.totalLagUs += stats.totalLagUs;
+        }
+        return total;
+    }
+
+    Acceptor::Stats Server::acceptStats() const {
         loop_->assertInLoopThread();
+        Acceptor::Stats total = acceptor_->stats();
+        if (unixAcceptor_) {
+            const Acceptor::Stats& stats = unixAcceptor_->stats();
+            total.wakeups += stats.wakeups;
+            total.accepted += stats.accepted;
+            total.maxPerWakeup = std::max(total.maxPerWakeup, stats.maxPerWakeup);
+            total.budgetExhausted += stats.budgetExhausted;
+            total.paused += stats.paused;
+        }
+        return total;
+    }
 
-        char buf[32];
-        snprintf(buf, sizeof buf, "#%d", nextConnId_);
-        ++nextConnId_;
-        std::string connName = name_ + buf;
+    int64_t Server::maxLoopLagUs() const {
+        int64_t lag = loop_->lagUs();
+        for (EventLoop* ioLoop : ioLoops_) {
+            lag = std::max(lag, ioLoop->lagUs());
+        }
+        return lag;
+    }
 
-        LOG_INFO("Server::newConnection [%s] - new connection [%s] from %s\n",
-                 name_.c_str(), connName.c_str(), peerAddr.toIpPort().c_str());
+    EventLoop* Server::getNextLoop(int sockfd) {
+        if (loadBalance_ == kIncomingCpu) {
+            /* 连接的软中断和协议栈处理在哪个CPU上, 就交给绑定在那个CPU上的subLoop, 数据不跨CPU和NUMA节点 */
+            int cpu = kvDB::getIncomingCpu(sockfd);
+            if (cpu >= 0 && static_cast<size_t>(cpu) < cpuLoops_.size() && cpuLoops_[cpu] != nullptr) {
+                return cpuLoops_[cpu];
+            }
+        }
+        if (loadBalance_ == kLeastConnections) {
+            EventLoop* ioLoop = nullptr;
+            size_t least = 0;
+            for (auto& item : loops_) {
+                if (ioLoop == nullptr || item.second.connections < least) {
+                    ioLoop = item.first;
+                    least = item.second.connections;
+                }
+            }
+            if (ioLoop != nullptr) {
+                return ioLoop;
+            }
+        }
+        return threadPool_->getNextLoop();
+    }
 
-        InetAddress localAddr(kvDB::getLocalAddr(sockfd));
-        TcpConnectionPtr conn = std::make_shared<TcpConnection>(loop_, connName, sockfd, localAddr, peerAddr);
-        connections_[connName] = conn;
+    void Server::newConnection(int sockfd, const InetAddress& peerAddr) {
+        loop_->assertInLoopThread();
+        /* 选择一个subLoop, 新连接之后的所有读写都在这个subLoop中进行 */
+        EventLoop* ioLoop = getNextLoop(sockfd);
+
+        const uint64_t connId = nextConnId_++;
+        LOG_DEBUG("Server::newConnection [%s] - new connection [#%lu] from %s\n",
+                  name_.c_str(), connId, peerAddr.toIpPort().c_str());
+
+        /* Unix域套接字的连接getsockname得不到路径，本端地址就是监听的地址 */
+        InetAddress localAddr = peerAddr.isUnix() ? unixAcceptor_->listenAddress() :
+                                InetAddress(kvDB::getLocalAddr(sockfd));
+        LoopContext& context = loops_[ioLoop];
+        TcpConnectionPtr conn = context.pool->acquire(connId, sockfd, localAddr, peerAddr);
+        if (static_cast<size_t>(sockfd) >= connections_.size()) {
+            connections_.resize(std::max(static_cast<size_t>(sockfd) + 1, connections_.size() * 2));
+        }
+        assert(!connections_[sockfd]);
+        connections_[sockfd] = conn;
+        ++context.connections;
 
+        conn->setEdgeTriggered(edgeTriggered_);
         conn->setConnectionCallback(connectionCallback_);
         conn->setMessageCallback(messageCallback_);
+        conn->setHighWaterMarkCallback(highWaterMarkCallback_, highWaterMark_);
+        conn->setLowWaterMarkCallback(lowWaterMarkCallback_, lowWaterMark_);
+        conn->setOutputLimit(outputLimit_);
+        conn->setZeroCopyThreshold(zeroCopyThreshold_);
+        if (context.idleWheel) {
+            conn->setIdleWheel(context.idleWheel);
+        }
+        if (context.flushQueue) {
+            conn->setFlushQueue(context.flushQueue);
+        }
+        if (socketBusyPollUs_ > 0 && !conn->setBusyPoll(socketBusyPollUs_)) {
+            /* 没有权限时每个连接都会失败, 只提示一次 */
+            LOG_WARN("SO_BUSY_POLL %d us not permitted:%d, disabled\n", socketBusyPollUs_, errno);
+            socketBusyPollUs_ = 0;
+        }
 
         conn->setCloseCallback(
                 std::bind(&Server::removeConnection, this, std::placeholders::_1));
-        loop_->runInLoop(
+        ioLoop->runInLoop(
                 std::bind(&TcpConnection::connectEstablished, conn));
     }
 
+    /* 在连接所属的subLoop中被调用, 转到baseLoop中修改connections_ */
     void Server::removeConnection(const TcpConnectionPtr& conn) {
         loop_->runInLoop(std::bind(&Server::removeConnectionInLoop, this, conn));
     }
 
     void Server::removeConnectionInLoop(const TcpConnectionPtr& conn) {
         loop_->assertInLoopThread();
-        LOG_INFO("Server::removeConnection [%s] - connection.\n", conn->name().c_str());
-        size_t n = connections_.erase(conn->name());
-        assert(n == 1);
-        loop_->runInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+        LOG_DEBUG("Server::removeConnection [%s] - connection [#%lu].\n", name_.c_str(), conn->id());
+        assert(connections_[conn->fd()] == conn);
+        connections_[conn->fd()].reset();
+        EventLoop* ioLoop = conn->getLoop();
+        --loops_[ioLoop].connections;
+        /* connectDestroyed必须在连接所属的subLoop中执行 */
+        ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
     }
 
-}
\ No newline at end of file
+}
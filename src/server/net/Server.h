@@ -13,23 +13,112 @@
 #define KVDB_SERVER_H
 
 #include "EventLoop.h"
+#include "EventLoopThreadPool.h"
 #include "InetAddress.h"
 #include "Callbacks.h"
 #include "Acceptor.h"
 #include "TcpConnection.h"
-#include <map>
+#include "TimingWheel.h"
+#include "FlushQueue.h"
+#include "ConnectionPool.h"
+#include <vector>
+#include <unordered_map>
 
 namespace kvDB {
     class Server {
     public:
+        using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+        /* 新连接分配到subLoop的策略 */
+        enum LoadBalance {
+            kRoundRobin,          // 轮询
+            kLeastConnections,    // 分配给当前连接数最少的subLoop
+            kIncomingCpu,         // 分配给绑定在处理该连接RX队列的CPU上的subLoop, 没有这样的subLoop时轮询
+        };
+
         Server(EventLoop* loop, const InetAddress& listenAddr, std::string name);
         ~Server();
 
+        /* 设置subLoop的个数，必须在start()之前调用
+         * 0: 所有的连接都在baseLoop中处理(默认)
+         * N: baseLoop只负责accept，新连接按loadBalance_分配给N个subLoop */
+        void setThreadNum(int numThreads);
+
+        /* 设置subLoop线程绑定的CPU, 第i个subLoop绑定cpus[i % cpus.size()], 必须在start()之前调用.
+         * 线程在创建loop之前绑定, 连接的缓冲区等在subLoop中分配的内存落在该CPU的NUMA节点上 */
+        void setThreadCpus(std::vector<int> cpus);
+
+        /* 设置新连接分配到subLoop的策略 */
+        void setLoadBalance(LoadBalance balance) { loadBalance_ = balance; }
+
+        /* 设置监听fd和新连接为边沿触发(EPOLLET)，必须在start()之前调用 */
+        void setEdgeTriggered(bool on);
+
+        /* 设置subLoop线程启动后，运行loop前执行的回调 */
+        void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+
+        /* 设置每个连接发送链的高/低水位: 超过高水位暂停读取该连接, 回落到低水位后恢复, 0表示不限制 */
+        void setOutputWaterMarks(size_t highWaterMark, size_t lowWaterMark) {
+            highWaterMark_ = highWaterMark;
+            lowWaterMark_ = lowWaterMark;
+        }
+        /* 设置每个连接发送链的硬上限, 超过时断开连接, 0表示不限制 */
+        void setOutputLimit(size_t limit) { outputLimit_ = limit; }
+
+        /* 设置零拷贝发送的阈值, 不小于这个大小的共享数据用MSG_ZEROCOPY发送, 0表示不使用(默认) */
+        void setZeroCopyThreshold(size_t threshold) { zeroCopyThreshold_ = threshold; }
+
+        /* 是否合并一轮事件中产生的回复, 在loop的beforeSleep阶段对每个连接只写一次(默认开启).
+         * 关闭时每次send直接写socket, 必须在start()之前调用 */
+        void setCoalesceReplies(bool on) { coalesceReplies_ = on; }
+
+        /* 设置忙轮询: 每个loop在有事件之后的windowUs微秒内不阻塞地poll, 0表示关闭(默认);
+         * socketUs大于0时给每个连接设置SO_BUSY_POLL. 必须在start()之前调用 */
+        void setBusyPoll(int64_t windowUs, int socketUs) {
+            busyPollUs_ = windowUs;
+            socketBusyPollUs_ = socketUs;
+        }
+
+        /* 所有处理连接的loop的poll统计之和, 可以在任意线程中调用 */
+        EventLoop::PollStats pollStats() const;
+
+        /* 设置空闲连接的超时时间(秒), 超过这个时间没有收到数据的连接会被关闭, 0表示不关闭.
+         * 必须在start()之前调用, 每个loop有一个自己的时间轮 */
+        void setIdleTimeout(double seconds) { idleTimeout_ = seconds; }
+
+        /* 在Unix域套接字path上增加一个监听，和TCP监听共用连接的处理流程，必须在start()之前调用.
+         * perm不为0时设置socket文件的权限 */
+        void listenUnix(const std::string& path, mode_t perm = 0);
+
+        /* 设置每次监听fd可读时最多accept的连接数(默认64)、listen的backlog(默认1024)
+         * 和TCP_DEFER_ACCEPT的秒数(默认0不开启)，必须在start()之前调用，对所有监听都生效 */
+        void setAcceptBudget(int budget) { acceptBudget_ = budget; }
+        void setListenBacklog(int backlog) { listenBacklog_ = backlog; }
+        void setDeferAccept(int seconds) { deferAccept_ = seconds; }
+
+        /* 设置过载的阈值(微秒): 有loop的延迟(EventLoop::lagUs)超过阈值时服务过载，暂停accept新连接，
+         * 0表示不检查(默认) */
+        void setLoopLagThreshold(int64_t us) { lagThresholdUs_ = us; }
+
+        /* baseLoop和所有subLoop中最大的延迟(微秒)，可以在任意线程中调用 */
+        int64_t maxLoopLagUs() const;
+
+        /* 是否有loop的延迟超过了阈值 */
+        bool overloaded() const {
+            int64_t threshold = lagThresholdUs_;
+            return threshold > 0 && maxLoopLagUs() > threshold;
+        }
+
+        /* 所有监听的accept统计之和，只能在baseLoop中调用 */
+        Acceptor::Stats acceptStats() const;
+
         /* 启动网络服务 */
         void start();
 
         void setConnectionCallback(const ConnectionCallback& cb){ connectionCallback_ = cb;}
         void setMessageCallback(const MessageCallback& cb){ messageCallback_ = cb;}
+        void setHighWaterMarkCallback(const HighWaterMarkCallback& cb){ highWaterMarkCallback_ = cb;}
+        void setLowWaterMarkCallback(const LowWaterMarkCallback& cb){ lowWaterMarkCallback_ = cb;}
 
     private:
         /* 新建连接(一个IP+Port可以建立多个客户端连接) */
@@ -39,19 +128,53 @@ namespace kvDB {
         /* 移除连接(将连接摧毁，从Server的map容器中移除) */
         void removeConnectionInLoop(const TcpConnectionPtr& conn);
 
-        /* first --> tcp连接名  second --> Tcp连接实例 */
-        using ConnectionMap = std::map<std::string, TcpConnectionPtr>;
+        /* 按loadBalance_选出新连接sockfd所属的subLoop */
+        EventLoop* getNextLoop(int sockfd);
 
-        EventLoop* loop_;
-        std::unique_ptr<Acceptor> acceptor_;
+        /* 以连接的fd为下标的连接表, fd是进程中最小的可用描述符, 所以表是稠密的.
+         * 连接从表中删除之后fd才会在对象回收时关闭, 所以同一个fd不会同时对应两个连接 */
+        using ConnectionMap = std::vector<TcpConnectionPtr>;
+
+        /* 每个subLoop的状态 */
+        struct LoopContext {
+            size_t connections = 0;                   // 当前的连接数
+            std::shared_ptr<ConnectionPool> pool;     // 连接对象池
+            std::shared_ptr<TimingWheel> idleWheel;   // 空闲连接时间轮, 没有设置空闲超时时为空
+            std::shared_ptr<FlushQueue> flushQueue;   // 回复合并队列, 关闭合并时为空
+        };
+
+        EventLoop* loop_;                        // baseLoop, 负责accept
         const std::string name_;                 // Server服务实例的名字
+        std::unique_ptr<Acceptor> acceptor_;
+        std::unique_ptr<Acceptor> unixAcceptor_; // Unix域套接字的监听，没有配置时为空
+        std::unique_ptr<EventLoopThreadPool> threadPool_;
 
         ConnectionCallback connectionCallback_;
         MessageCallback    messageCallback_;
+        ThreadInitCallback threadInitCallback_;
+        HighWaterMarkCallback highWaterMarkCallback_;
+        LowWaterMarkCallback  lowWaterMarkCallback_;
 
+        LoadBalance loadBalance_;
+        bool edgeTriggered_;                     // 新连接是否使用边沿触发
+        size_t highWaterMark_;                   // 连接发送链的高水位
+        size_t lowWaterMark_;                    // 连接发送链的低水位
+        size_t outputLimit_;                     // 连接发送链的硬上限
+        double idleTimeout_;                     // 空闲连接的超时时间(秒)
+        size_t zeroCopyThreshold_;               // 零拷贝发送的阈值
+        bool coalesceReplies_;                   // 是否合并一轮事件中的回复
+        int64_t busyPollUs_;                     // loop忙轮询的窗口(微秒)
+        int socketBusyPollUs_;                   // 连接的SO_BUSY_POLL(微秒)
+        std::vector<EventLoop*> ioLoops_;        // 处理连接的loop, start()之后不变
+        std::vector<EventLoop*> cpuLoops_;       // 以CPU编号为下标, 绑定在该CPU上的subLoop, 没有时为空
+        int acceptBudget_;                       // 每次读事件最多accept的连接数
+        int listenBacklog_;                      // listen的backlog
+        int deferAccept_;                        // TCP_DEFER_ACCEPT的秒数
+        std::atomic<int64_t> lagThresholdUs_;    // 过载的延迟阈值(微秒)，运行中可以修改
         bool started_;                           // 网络服务是否启动
-        int nextConnId_;                         // 下一个Tcp连接的Id
-        ConnectionMap connections_;              // 连接名与Tcp连接的映射
+        uint64_t nextConnId_;                    // 下一个Tcp连接的Id
+        ConnectionMap connections_;              // fd与Tcp连接的映射
+        std::unordered_map<EventLoop*, LoopContext> loops_;  // 每个subLoop的连接数、对象池、时间轮和回复合并队列
     };
 }
 
@@ -0,0 +1,76 @@
+/**
+  ******************************************************************************
+  * @file           : SignalHandler.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-23
+  ******************************************************************************
+  */
+
+
+#include "SignalHandler.h"
+#include "EventLoop.h"
+#include "../comm/Logger.h"
+#include <sys/signalfd.h>
+#include <pthread.h>
+#include <unistd.h>
+
+namespace kvDB {
+    sigset_t emptySignalSet() {
+        sigset_t mask;
+        sigemptyset(&mask);
+        return mask;
+    }
+
+    /* 先用空的信号集创建signalfd，add时再更新 */
+    int createSignalfd(const sigset_t* mask) {
+        int fd = ::signalfd(-1, mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (fd < 0) {
+            LOG_FATAL("signalfd error:%d\n", errno);
+        }
+        return fd;
+    }
+
+    SignalHandler::SignalHandler(EventLoop* loop)
+            : loop_(loop),
+              mask_(emptySignalSet()),
+              signalFd_(createSignalfd(&mask_)),
+              channel_(loop, signalFd_) {
+        channel_.setReadCallback(std::bind(&SignalHandler::handleRead, this));
+        channel_.enableReading();
+    }
+
+    SignalHandler::~SignalHandler() {
+        channel_.disableAll();
+        channel_.remove();
+        ::close(signalFd_);
+        ::pthread_sigmask(SIG_UNBLOCK, &mask_, nullptr);
+    }
+
+    void SignalHandler::add(int signo, SignalCallback cb) {
+        loop_->assertInLoopThread();
+        sigset_t one;
+        sigemptyset(&one);
+        sigaddset(&one, signo);
+        ::pthread_sigmask(SIG_BLOCK, &one, nullptr);
+
+        sigaddset(&mask_, signo);
+        if (::signalfd(signalFd_, &mask_, 0) < 0) {
+            LOG_ERROR("signalfd add signal %d error:%d\n", signo, errno);
+        }
+        callbacks_[signo] = std::move(cb);
+    }
+
+    void SignalHandler::handleRead() {
+        loop_->assertInLoopThread();
+        signalfd_siginfo info;
+        /* 同一个信号在排队时会合并，一次可读事件可能对应多个信号 */
+        while (::read(signalFd_, &info, sizeof info) == sizeof info) {
+            auto it = callbacks_.find(static_cast<int>(info.ssi_signo));
+            if (it != callbacks_.end()) {
+                it->second(static_cast<int>(info.ssi_signo));
+            }
+        }
+    }
+}
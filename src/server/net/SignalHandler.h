@@ -0,0 +1,47 @@
+/**
+  ******************************************************************************
+  * @file           : SignalHandler.h
+  * @author         : zgys
+  * @brief          : 用signalfd把信号变成loop中的读事件
+  * @attention      : 只能在所属loop的线程中使用
+  * @date           : 23-4-23
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_SIGNALHANDLER_H
+#define KVDB_SIGNALHANDLER_H
+
+#include <csignal>
+#include <unordered_map>
+#include "../comm/Noncopyable.h"
+#include "Callbacks.h"
+#include "Channel.h"
+
+namespace kvDB {
+    class EventLoop;
+
+    /* 关心的信号在线程中被屏蔽，内核把它们排队到signalfd，signalfd作为普通的Channel注册到loop.
+     * 回调在loop线程中执行，不受异步信号安全的限制，可以加锁、分配内存、写日志 */
+    class SignalHandler : Noncopyable {
+    public:
+        explicit SignalHandler(EventLoop* loop);
+        ~SignalHandler();
+
+        /* 在loop中处理信号signo，同一个信号重复设置时替换回调.
+         * 信号只在调用线程中被屏蔽，必须在创建其他线程之前调用，之后创建的线程继承屏蔽字 */
+        void add(int signo, SignalCallback cb);
+
+    private:
+        /* signalfd可读时读出所有排队的信号，执行对应的回调 */
+        void handleRead();
+
+        EventLoop* loop_;
+        sigset_t mask_;      // 关心的信号
+        int signalFd_;
+        Channel channel_;
+        std::unordered_map<int, SignalCallback> callbacks_;
+    };
+}
+
+#endif //KVDB_SIGNALHANDLER_H
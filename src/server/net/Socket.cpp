@@ -25,18 +25,25 @@ namespace kvDB {
     }
 
     void Socket::bindAddress(const InetAddress& localAddr) const {
-        kvDB::bind(sockfd_,localAddr.getSockAddr());
+        int ret = ::bind(sockfd_, localAddr.getSockAddrPtr(), localAddr.getSockLen());
+        if (ret < 0) {
+            LOG_FATAL("bind %s fail:%d\n", localAddr.toIpPort().c_str(), errno);
+        }
     }
 
-    void Socket::listen() const {
-        int ret = ::listen(sockfd_, 1024);
+    void Socket::listen(int backlog) const {
+        int ret = ::listen(sockfd_, backlog);
         if (ret != 0) {
             LOG_FATAL("listen sockfd:%d fail\n", sockfd_);
         }
     }
 
     int Socket::accept(InetAddress *peerAddr) const {
-        sockaddr_in addr;
+        /* 监听fd可能是TCP或者Unix域套接字，按较大的地址接收 */
+        union {
+            sockaddr_in in;
+            sockaddr_un un;
+        } addr;
         socklen_t len;
 
         bzero(&addr, sizeof addr);
@@ -44,7 +51,11 @@ namespace kvDB {
 
         int connfd = ::accept4(sockfd_, (sockaddr *) &addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
         if (connfd >= 0) {
-            peerAddr->setSockAddr(addr);
+            if (addr.un.sun_family == AF_UNIX) {
+                peerAddr->setSockAddr(addr.un);
+            } else {
+                peerAddr->setSockAddr(addr.in);
+            }
         }
         return connfd;
     }
@@ -75,8 +86,21 @@ namespace kvDB {
         ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof optval);
     }
 
-    int createNonblockingOrDie() {
-        int sockfd = ::socket(AF_INET, SOCK_STREAM, 0);
+    void Socket::setDeferAccept(int seconds) {
+        ::setsockopt(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &seconds, sizeof seconds);
+    }
+
+    bool Socket::setBusyPoll(int usec) {
+        return ::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof usec) == 0;
+    }
+
+    bool Socket::setZeroCopy(bool on) {
+        int optval = on ? 1 : 0;
+        return ::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof optval) == 0;
+    }
+
+    int createNonblockingOrDie(sa_family_t family) {
+        int sockfd = ::socket(family, SOCK_STREAM, 0);
         if (sockfd < 0) {
             LOG_FATAL("%s:%s:%d listen socket create err:%d\n", __FILE__, __FUNCTION__, __LINE__, errno);
         }
@@ -132,6 +156,15 @@ namespace kvDB {
         return localAddr;
     }
 
+    int getIncomingCpu(int sockfd) {
+        int cpu = -1;
+        socklen_t len = static_cast<socklen_t>(sizeof cpu);
+        if (::getsockopt(sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, &len) < 0) {
+            return -1;
+        }
+        return cpu;
+    }
+
     sockaddr_in getPeerAddr(int sockfd) {
         struct sockaddr_in peerAddr = {0};
         memset(&peerAddr, 0, sizeof peerAddr);
@@ -36,8 +36,8 @@ namespace kvDB {
         /* 绑定网络地址 */
         void bindAddress(const InetAddress& localAddr) const;
 
-        /* 监听套接字 */
-        void listen() const;
+        /* 监听套接字，backlog为已完成握手、等待accept的连接队列长度(受net.core.somaxconn限制) */
+        void listen(int backlog = 1024) const;
         int accept(InetAddress * peerAddr) const;
 
         void shutdownWrite() const;
@@ -58,11 +58,21 @@ namespace kvDB {
         /* 设置Tcp层的心跳包 */
         void setKeepAlive(bool on);
 
+        /* 设置TCP_DEFER_ACCEPT，客户端发来数据(或者超过seconds秒)之后监听fd才可读，0表示关闭 */
+        void setDeferAccept(int seconds);
+
+        /* 设置SO_BUSY_POLL(微秒): 读socket没有数据时在网卡队列上忙等, 超过系统的net.core.busy_read时需要CAP_NET_ADMIN,
+         * 失败时返回false */
+        bool setBusyPoll(int usec);
+
+        /* 设置SO_ZEROCOPY，之后才可以用MSG_ZEROCOPY发送，内核不支持时返回false */
+        bool setZeroCopy(bool on);
+
     private:
         const int sockfd_;
     };
 
-    int createNonblockingOrDie();
+    int createNonblockingOrDie(sa_family_t family = AF_INET);
     void setNonBlockAndCloseOnExec(int sockfd);
     int connect(int sockfd,const sockaddr_in & addr);
     void bind(int sockfd,const sockaddr_in & addr);
@@ -72,6 +82,8 @@ namespace kvDB {
     const sockaddr* sockaddr_cast(const sockaddr_in* addr);
     sockaddr_in getLocalAddr(int sockfd);
     sockaddr_in getPeerAddr(int sockfd);
+    /* 处理这个连接的RX队列(网卡中断/软中断)所在的CPU(SO_INCOMING_CPU)，取不到时返回-1 */
+    int getIncomingCpu(int sockfd);
     int getSocketError(int sockfd);
 
 }
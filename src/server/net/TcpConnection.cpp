@@ -14,6 +14,11 @@
 #include "Channel.h"
 
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <cstring>
 
 namespace kvDB {
     void defaultConnectionCallback(const TcpConnectionPtr& conn) {
@@ -30,17 +35,25 @@ namespace kvDB {
     }
 
     TcpConnection::TcpConnection(EventLoop *loop,
-                                 std::string& name,
+                                 uint64_t id,
                                  int sockfd,
                                  const InetAddress& localAddr,
                                  const InetAddress& peerAddr)
             : loop_(loop),
-              name_(name),
+              id_(id),
               state_(kConnecting),
-              socket_(new Socket(sockfd)),
+              socket_(std::in_place, sockfd),
               channel_(new Channel(loop, sockfd)),
               localAddr_(localAddr),
-              peerAddr_(peerAddr) {
+              peerAddr_(peerAddr),
+              highWaterMark_(0),
+              lowWaterMark_(0),
+              outputLimit_(0),
+              readPending_(false),
+              readingPaused_(false),
+              flushPending_(false),
+              messagePending_(false),
+              idleEntry_(this) {
 
         channel_->setReadCallback(
                 std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
@@ -52,31 +65,101 @@ namespace kvDB {
                 std::bind(&TcpConnection::handleError, this));
     }
 
+    void TcpConnection::reset(uint64_t id, int sockfd, const InetAddress& localAddr, const InetAddress& peerAddr) {
+        id_ = id;
+        state_ = kConnecting;
+        socket_.emplace(sockfd);
+        channel_->reset(sockfd);
+        localAddr_ = localAddr;
+        peerAddr_ = peerAddr;
+    }
+
+    bool TcpConnection::recycle() {
+        if (channel_->index() != -1 || idleEntry_.linked()) {
+            return false;
+        }
+        socket_.reset();
+        inputBuffer_.retrieveAll();
+        inputBuffer_.shrink();
+        outputChain_.retrieveAll();
+        outputChain_.releasePinned();
+        outputChain_.setZeroCopyThreshold(0);
+        idleWheel_.reset();
+        flushQueue_.reset();
+        readPending_ = false;
+        flushPending_ = false;
+        messagePending_ = false;
+        readingPaused_ = false;
+        context_.reset();
+        return true;
+    }
+
     void TcpConnection::connectEstablished() {
         loop_->assertInLoopThread();
         assert(state_ == kConnecting);
         setState(kConnected);
         channel_->tie(shared_from_this());
         channel_->enableReading();
+        if (idleWheel_) {
+            idleWheel_->add(&idleEntry_);
+        }
+        if (channel_->isEdgeTriggered()) {
+            /* 边沿触发只在发送缓冲区由满变为可写时通知, 注册一次EPOLLOUT之后不再修改 */
+            channel_->enableWriting();
+        }
 
         connectionCallback_(shared_from_this());
     }
 
     void TcpConnection::connectDestroyed() {
         loop_->assertInLoopThread();
-        assert(state_ == kConnected || state_ == kDisconnecting);
-        setState(kDisConnected);
-        channel_->disableAll();
+        /* 由handleClose关闭的连接已经是kDisConnected; Server析构时销毁的连接还没有关闭 */
+        if (state_ == kConnected || state_ == kDisconnecting) {
+            setState(kDisConnected);
+            channel_->disableAll();
+        }
+        if (idleWheel_) {
+            idleWheel_->remove(&idleEntry_);
+        }
         connectionCallback_(shared_from_this());
         loop_->removeChannel(channel_.get());
     }
 
     void TcpConnection::send(const std::string& message) {
+        send(Slice(message));
+    }
+
+    void TcpConnection::send(std::string&& message) {
+        send(Slice(std::move(message)));
+    }
+
+    void TcpConnection::send(std::shared_ptr<const std::string> message) {
+        send(Slice(std::move(message)));
+    }
+
+    void TcpConnection::send(Slice&& slice) {
         if (state_ == kConnected) {
             if (loop_->isInLoopThread()) {
-                sendInLoop(message);
+                sendInLoop(std::move(slice));
             } else {
-                loop_->runInLoop(std::bind(&TcpConnection::sendInLoop, this, message));
+                /* 持有连接的shared_ptr, 保证回调执行时连接还没有被析构 */
+                loop_->queueInLoop(
+                        [conn = shared_from_this(), s = std::move(slice)]() mutable {
+                            conn->sendInLoop(std::move(s));
+                        });
+            }
+        }
+    }
+
+    void TcpConnection::send(OutputChain&& chain) {
+        if (state_ == kConnected) {
+            if (loop_->isInLoopThread()) {
+                sendInLoop(std::move(chain));
+            } else {
+                loop_->queueInLoop(
+                        [conn = shared_from_this(), c = std::move(chain)]() mutable {
+                            conn->sendInLoop(std::move(c));
+                        });
             }
         }
     }
@@ -84,7 +167,28 @@ namespace kvDB {
     void TcpConnection::shutdown() {
         if (state_ == kConnected) {
             setState(kDisconnecting);
-            loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop, this));
+            loop_->runInLoop(std::bind(&TcpConnection::shutdownInLoop, shared_from_this()));
+        }
+    }
+
+    void TcpConnection::forceClose() {
+        if (state_ == kConnected || state_ == kDisconnecting) {
+            setState(kDisconnecting);
+            loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+        }
+    }
+
+    void TcpConnection::setEdgeTriggered(bool on) {
+        assert(state_ == kConnecting);
+        channel_->setEdgeTriggered(on);
+    }
+
+    void TcpConnection::setZeroCopyThreshold(size_t threshold) {
+        assert(state_ == kConnecting);
+        if (threshold > 0 && socket_->setZeroCopy(true)) {
+            outputChain_.setZeroCopyThreshold(threshold);
+        } else {
+            outputChain_.setZeroCopyThreshold(0);
         }
     }
 
@@ -97,11 +201,24 @@ namespace kvDB {
     }
 
     void TcpConnection::handleRead(Timestamp receiveTime) {
+        loop_->assertInLoopThread();
+        if (!channel_->isReading()) {
+            // 暂停读取时边沿触发仍可能收到EPOLLRDHUP, 恢复读取时会重新通知
+            return;
+        }
+        if (channel_->isEdgeTriggered()) {
+            handleReadEdgeTriggered(receiveTime);
+            return;
+        }
         int saveErrno = 0;
         /* 将信息从内核缓冲区中读到应用层Buffer */
         ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
         if (n > 0) {
+            if (idleWheel_) {
+                idleWheel_->touch(&idleEntry_);
+            }
             messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            inputBuffer_.shrink();
         } else if (n == 0) {
             /* 内核的TCP程序会进行四次挥手关闭连接，如果应用层正在读取数据：
             ①.如果数据没有读完，会继续读取缓冲区的数据；
@@ -118,80 +235,365 @@ namespace kvDB {
         }
     }
 
+    void TcpConnection::handleReadEdgeTriggered(Timestamp receiveTime) {
+        int saveErrno = 0;
+        size_t total = 0;
+        bool drained = false;    // 内核缓冲区已经读空
+        bool peerClosed = false; // 读到了EOF
+        bool error = false;
+
+        /* 边沿触发时, 没有读空的数据不会再通知, 所以一直读到EAGAIN.
+         * 一次readv没有读满说明内核缓冲区已经空了, 之后再有数据到来会产生新的边沿, 不需要再用一次read确认EAGAIN;
+         * 但如果对端已经关闭(EPOLLRDHUP), 需要继续读到EOF, 否则不会再收到通知 */
+        while (total < kMaxReadBytesPerEvent) {
+            inputBuffer_.allocate();
+            const size_t wanted = inputBuffer_.writableBytes() + Buffer::kExtraBufSize;
+            ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
+            if (n > 0) {
+                total += static_cast<size_t>(n);
+                if (static_cast<size_t>(n) < wanted && !(channel_->revents() & EPOLLRDHUP)) {
+                    drained = true;
+                    break;
+                }
+            } else if (n == 0) {
+                peerClosed = true;
+                break;
+            } else if (saveErrno == EAGAIN || saveErrno == EWOULDBLOCK) {
+                drained = true;
+                break;
+            } else if (saveErrno != EINTR) {
+                error = true;
+                break;
+            }
+        }
+
+        if (total > 0) {
+            if (idleWheel_) {
+                idleWheel_->touch(&idleEntry_);
+            }
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            inputBuffer_.shrink();
+        }
+        if (peerClosed) {
+            handleClose();
+        } else if (error) {
+            errno = saveErrno;
+            LOG_ERROR("TcpConnection::handleRead error.\n");
+            handleError();
+        } else if (!drained && !readPending_) {
+            /* 超过了一次事件的读取预算, 内核中还有数据但不会再有新的边沿通知,
+             * 在本轮其他channel处理完之后继续读, 避免一个连接饿死其他连接 */
+            readPending_ = true;
+            loop_->queueInLoop([conn = shared_from_this()]() {
+                conn->readPending_ = false;
+                if ((conn->state_ == kConnected || conn->state_ == kDisconnecting)
+                    && conn->channel_->isReading()) {
+                    conn->handleReadEdgeTriggered(Timestamp::now());
+                }
+            });
+        }
+    }
+
+    void TcpConnection::deferMessage() {
+        loop_->assertInLoopThread();
+        if (!messagePending_) {
+            messagePending_ = true;
+            loop_->queueInLoop([conn = shared_from_this()]() { conn->handleDeferredMessage(); });
+        }
+    }
+
+    void TcpConnection::handleDeferredMessage() {
+        if (!messagePending_) {
+            return;
+        }
+        if (state_ != kConnected && state_ != kDisconnecting) {
+            messagePending_ = false;
+            return;
+        }
+        if (!channel_->isReading()) {
+            // 超过高水位暂停了读取, 由checkOutputDrained在恢复读取时继续
+            return;
+        }
+        messagePending_ = false;
+        if (inputBuffer_.readableBytes() > 0) {
+            messageCallback_(shared_from_this(), &inputBuffer_, Timestamp::now());
+            inputBuffer_.shrink();
+        }
+    }
+
     void TcpConnection::handleWrite() {
         loop_->assertInLoopThread();
-        if (channel_->isWriting()) {
-            ssize_t n = ::write(channel_->fd(),
-                                outputBuffer_.peek(),
-                                outputBuffer_.readableBytes());
-            if (n > 0) {
-                outputBuffer_.retrieve(n);
-                if (outputBuffer_.readableBytes() == 0) {
-                    channel_->disableWriting();
+        if (channel_->isEdgeTriggered()) {
+            // 边沿触发时EPOLLOUT一直被关心, 没有待发送的数据就直接返回
+            if (outputChain_.empty()) {
+                return;
+            }
+        } else if (!channel_->isWriting()) {
+            LOG_DEBUG("Connection is down, no more writing.");
+            return;
+        }
 
-                    if (writeCompleteCallback_) {
-                        loop_->runInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-                    }
-                    if (state_ == kDisconnecting) {
-                        shutdownInLoop();
-                    }
-                } else {
-                    LOG_DEBUG("I am going to write more data.");
+        int savedErrno = 0;
+        ssize_t n = outputChain_.writeFd(channel_->fd(), &savedErrno);
+        if (n > 0) {
+            checkOutputDrained();
+            if (outputChain_.empty()) {
+                if (!channel_->isEdgeTriggered()) {
+                    channel_->disableWriting();
+                }
+                if (writeCompleteCallback_) {
+                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                }
+                if (state_ == kDisconnecting) {
+                    shutdownInLoop();
                 }
             } else {
-                LOG_FATAL("TcpConnection::handleWrite, but the fd in channel not care about write event");
+                LOG_DEBUG("I am going to write more data.");
             }
-        } else {
-            LOG_DEBUG("Connection is down, no more writing.")
+        } else if (n < 0 && savedErrno != EAGAIN && savedErrno != EWOULDBLOCK) {
+            LOG_ERROR("TcpConnection::handleWrite error:%d\n", savedErrno);
         }
     }
 
     void TcpConnection::handleClose() {
         loop_->assertInLoopThread();
-        LOG_INFO("TcpConnection::handleClose state = %d.\n", state_);
+        LOG_DEBUG("TcpConnection::handleClose state = %d.\n", static_cast<int>(state_.load()));
         assert(state_ == kConnected || state_ == kDisconnecting);
+        setState(kDisConnected);
         channel_->disableAll();
+        if (idleWheel_) {
+            idleWheel_->remove(&idleEntry_);
+        }
         closeCallback_(shared_from_this());
     }
 
     void TcpConnection::handleError() {
+        bool notified = false;
+        if (outputChain_.zeroCopyThreshold() > 0 || outputChain_.pinnedCount() > 0) {
+            notified = readErrorQueue();
+        }
         int err = kvDB::getSocketError(channel_->fd());
-        LOG_ERROR("TcpConnection::handleError [%s]-SO_ERROR=%d.\n", err);
+        if (err == 0 && notified) {
+            // 只是零拷贝的完成通知
+            return;
+        }
+        LOG_ERROR("TcpConnection::handleError [%s]-SO_ERROR=%d.\n", name().c_str(), err);
     }
 
-    void TcpConnection::sendInLoop(const std::string& message) {
+    bool TcpConnection::readErrorQueue() {
+        bool notified = false;
+        char control[128];
+        while (true) {
+            msghdr msg;
+            memset(&msg, 0, sizeof msg);
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof control;
+            if (::recvmsg(channel_->fd(), &msg, MSG_ERRQUEUE) < 0) {
+                break;
+            }
+            for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+                if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR)
+                      || (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+                    continue;
+                }
+                auto* serr = reinterpret_cast<sock_extended_err*>(CMSG_DATA(cm));
+                if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0) {
+                    continue;
+                }
+                notified = true;
+                outputChain_.onZeroCopyCompleted(serr->ee_info, serr->ee_data);
+                if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                    /* 内核还是进行了拷贝(如回环网卡或网卡不支持scatter-gather), 零拷贝只剩额外的开销 */
+                    outputChain_.setZeroCopyThreshold(0);
+                }
+            }
+        }
+        return notified;
+    }
+
+    void TcpConnection::sendInLoop(Slice&& slice) {
         loop_->assertInLoopThread();
+        if (state_ == kDisConnected) {
+            LOG_ERROR("TcpConnection::sendInLoop disconnected, give up writing.\n");
+            return;
+        }
+        if (flushQueue_) {
+            const size_t oldLen = outputChain_.readableBytes();
+            outputChain_.append(std::move(slice));
+            deferFlush(oldLen);
+            return;
+        }
+        if (outputChain_.useZeroCopy(slice)) {
+            /* 零拷贝发送的数据要由发送链持有到完成通知到达, 经过发送链发送 */
+            OutputChain chain;
+            chain.append(std::move(slice));
+            sendInLoop(std::move(chain));
+            return;
+        }
         ssize_t nwrote = 0;
-        // 发送缓冲区没有数据
-        if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
-            nwrote = ::write(channel_->fd(), message.data(), message.size());
+        bool faultError = false;
+        /* 发送链中没有数据时直接写socket.
+         * 水平触发时isWriting()表示还有数据在等待EPOLLOUT; 边沿触发时EPOLLOUT一直被关心, 只看发送链 */
+        if (outputChain_.empty() &&
+            (channel_->isEdgeTriggered() || !channel_->isWriting())) {
+            nwrote = ::write(channel_->fd(), slice.data(), slice.size());
             if (nwrote >= 0) {
-                if (static_cast<size_t>(nwrote) < message.size()) {
+                if (static_cast<size_t>(nwrote) < slice.size()) {
                     LOG_DEBUG("I am going to write more data.");
                 } else if (writeCompleteCallback_) {
-                    loop_->runInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
                 }
             } else {
                 nwrote = 0;
-                if (errno != EAGAIN) {
-                    LOG_FATAL("TcpConnection::sendInLoop.");
-                }
+                faultError = handleDirectWriteError(errno);
             }
         }
         assert(nwrote >= 0);
-        if (static_cast<size_t>(nwrote) < message.size()) {
-            outputBuffer_.append(message.data() + nwrote, message.size() - nwrote);
-            if (!channel_->isWriting()) {
+        if (!faultError && static_cast<size_t>(nwrote) < slice.size()) {
+            /* 剩余的数据片直接挂到发送链上, 不拷贝 */
+            const size_t oldLen = outputChain_.readableBytes();
+            slice.retrieve(static_cast<size_t>(nwrote));
+            outputChain_.append(std::move(slice));
+            if (!channel_->isEdgeTriggered() && !channel_->isWriting()) {
                 channel_->enableWriting();
             }
+            checkOutputGrown(oldLen);
+        }
+    }
+
+    void TcpConnection::sendInLoop(OutputChain&& chain) {
+        loop_->assertInLoopThread();
+        if (state_ == kDisConnected) {
+            LOG_ERROR("TcpConnection::sendInLoop disconnected, give up writing.\n");
+            return;
+        }
+        /* 发送链为空时先挂到发送链上再直接写socket, 与发送链中的数据一起用writev发送 */
+        const size_t oldLen = outputChain_.readableBytes();
+        outputChain_.append(std::move(chain));
+        if (flushQueue_) {
+            deferFlush(oldLen);
+            return;
+        }
+        if (oldLen == 0 &&
+            (channel_->isEdgeTriggered() || !channel_->isWriting())) {
+            int savedErrno = 0;
+            if (outputChain_.writeFd(channel_->fd(), &savedErrno) < 0 && handleDirectWriteError(savedErrno)) {
+                outputChain_.retrieveAll();
+                return;
+            }
+            if (outputChain_.empty()) {
+                if (writeCompleteCallback_) {
+                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                }
+                return;
+            }
+        }
+        if (!channel_->isEdgeTriggered() && !channel_->isWriting()) {
+            channel_->enableWriting();
+        }
+        checkOutputGrown(oldLen);
+    }
+
+    void TcpConnection::deferFlush(size_t oldLen) {
+        if (!flushPending_) {
+            flushPending_ = true;
+            flushQueue_->add(shared_from_this());
+        }
+        checkOutputGrown(oldLen);
+    }
+
+    void TcpConnection::flushOutput() {
+        loop_->assertInLoopThread();
+        flushPending_ = false;
+        if (state_ == kDisConnected || outputChain_.empty()) {
+            return;
+        }
+        if (!channel_->isEdgeTriggered() && channel_->isWriting()) {
+            // 水平触发时还在等待EPOLLOUT, 由handleWrite发送
+            return;
+        }
+        int savedErrno = 0;
+        ssize_t n = outputChain_.writeFd(channel_->fd(), &savedErrno);
+        if (n < 0 && handleDirectWriteError(savedErrno)) {
+            outputChain_.retrieveAll();
+            return;
+        }
+        if (n > 0) {
+            checkOutputDrained();
+        }
+        if (outputChain_.empty()) {
+            if (writeCompleteCallback_) {
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+            if (state_ == kDisconnecting) {
+                shutdownInLoop();
+            }
+        } else if (!channel_->isEdgeTriggered()) {
+            channel_->enableWriting();
+        }
+    }
+
+    bool TcpConnection::handleDirectWriteError(int savedErrno) {
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) {
+            return false;
+        }
+        LOG_ERROR("TcpConnection::sendInLoop error:%d\n", savedErrno);
+        return savedErrno == EPIPE || savedErrno == ECONNRESET;
+    }
+
+    void TcpConnection::checkOutputGrown(size_t oldLen) {
+        const size_t len = outputChain_.readableBytes();
+        if (outputLimit_ > 0 && len > outputLimit_) {
+            /* 客户端读得太慢, 丢弃待发送的数据并断开, 保护服务器的内存 */
+            LOG_ERROR("TcpConnection [%s] output %zu bytes exceeds limit %zu, closing.\n",
+                      name().c_str(), len, outputLimit_);
+            outputChain_.retrieveAll();
+            forceCloseInLoop();
+            return;
+        }
+        if (highWaterMark_ > 0 && oldLen < highWaterMark_ && len >= highWaterMark_) {
+            if (!readingPaused_ && channel_->isReading()) {
+                readingPaused_ = true;
+                channel_->disableReading();
+            }
+            if (highWaterMarkCallback_) {
+                loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), len));
+            }
+        }
+    }
+
+    void TcpConnection::checkOutputDrained() {
+        const size_t len = outputChain_.readableBytes();
+        if (readingPaused_ && len <= lowWaterMark_) {
+            readingPaused_ = false;
+            if (state_ == kConnected) {
+                channel_->enableReading();
+                if (messagePending_) {
+                    // 暂停期间没有处理完的数据不会再有读事件通知
+                    loop_->queueInLoop([conn = shared_from_this()]() { conn->handleDeferredMessage(); });
+                }
+            }
+            if (lowWaterMarkCallback_) {
+                loop_->queueInLoop(std::bind(lowWaterMarkCallback_, shared_from_this(), len));
+            }
         }
     }
 
     void TcpConnection::shutdownInLoop() {
         loop_->assertInLoopThread();
-        if (!channel_->isWriting()) {
+        if (outputChain_.empty() &&
+            (channel_->isEdgeTriggered() || !channel_->isWriting())) {
             socket_->shutdownWrite();
         }
     }
 
-}
\ No newline at end of file
+    void TcpConnection::forceCloseInLoop() {
+        loop_->assertInLoopThread();
+        if (state_ == kConnected || state_ == kDisconnecting) {
+            // 和对端关闭一样处理
+            setState(kDisconnecting);
+            handleClose();
+        }
+    }
+
+}
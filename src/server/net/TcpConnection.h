@@ -12,12 +12,18 @@
 #ifndef KVDB_TCPCONNECTION_H
 #define KVDB_TCPCONNECTION_H
 
+#include <any>
+#include <atomic>
 #include <memory>
 #include <string>
+#include <optional>
 #include "EventLoop.h"
 #include "InetAddress.h"
 #include "Callbacks.h"
 #include "Socket.h"
+#include "OutputChain.h"
+#include "TimingWheel.h"
+#include "FlushQueue.h"
 
 
 namespace kvDB {
@@ -26,13 +32,13 @@ namespace kvDB {
         /**
          * @brief 构造
          * @param loop 此tcp连接实例执行的循环
-         * @param name tcp连接名
+         * @param id 连接的编号，在Server中唯一
          * @param sockfd 网络套接字
          * @param localAddr 本地地址
          * @param peerAddr 源地址
          */
         TcpConnection(EventLoop* loop,
-                      std::string& name,
+                      uint64_t id,
                       int sockfd,
                       const InetAddress & localAddr,
                       const InetAddress & peerAddr);
@@ -41,8 +47,12 @@ namespace kvDB {
 
         /* 获取Tcp连接的事件循环 */
         EventLoop* getLoop() const { return loop_; }
-        /* 获取Tcp连接名称 */
-        const std::string& name() const { return name_; }
+        /* 获取Tcp连接的编号 */
+        uint64_t id() const { return id_; }
+        /* 获取Tcp连接名称，只在打印日志时使用，每次调用都会格式化 */
+        std::string name() const { return "#" + std::to_string(id_); }
+        /* 获取连接的网络套接字 */
+        int fd() const { return socket_->fd(); }
         /* 获取本地地址 */
         const InetAddress& localAddr() const{ return localAddr_; };
         /* 获取源地址 */
@@ -55,6 +65,24 @@ namespace kvDB {
         void setWriteCompletedCallback(const WriteCompleteCallback & cb){ writeCompleteCallback_ = cb;}
         void setCloseCallback(const CloseCallback & cb){ closeCallback_ = cb;}
 
+        /* 发送链超过highWaterMark时暂停读取这个连接(不再接收新的命令)并执行cb, 0表示不限制 */
+        void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark) {
+            highWaterMarkCallback_ = cb;
+            highWaterMark_ = highWaterMark;
+        }
+        /* 暂停读取后发送链回落到lowWaterMark以下时恢复读取并执行cb */
+        void setLowWaterMarkCallback(const LowWaterMarkCallback& cb, size_t lowWaterMark) {
+            lowWaterMarkCallback_ = cb;
+            lowWaterMark_ = lowWaterMark;
+        }
+        /* 发送链的硬上限, 超过时直接断开连接, 0表示不限制 */
+        void setOutputLimit(size_t limit) { outputLimit_ = limit; }
+
+        /* 发送链中待发送的字节数, 只能在loop线程中调用 */
+        size_t outputBytes() const { return outputChain_.readableBytes(); }
+        /* 是否因为超过高水位暂停了读取 */
+        bool readingPaused() const { return readingPaused_; }
+
         /* 当接收了一个新连接后调用.
          * TcpConnection建立完成， 状态置为：kConnected， channel中使用弱引用指向此连接实例
          * channel中的fd关心读事件，执行tcp连接建立的回调*/
@@ -65,11 +93,53 @@ namespace kvDB {
          * 执行连接建立的回调*/
         void connectDestroyed();
 
-        /* 发送消息 */
+        /* 发送消息, 可以在任意线程中调用.
+         * 不在连接所属的loop线程时, 消息被移动到回调中投递给loop线程发送.
+         * 右值string、共享的value和静态数据直接作为数据片进入发送链, 不会拷贝 */
         void send(const std::string& message);
+        void send(std::string&& message);
+        void send(std::shared_ptr<const std::string> message);
+        void send(Slice&& slice);
+        /* 由多个数据片组成的回复, 用一次writev发送 */
+        void send(OutputChain&& chain);
+
+        /* 在消息回调中调用: 回调用完了本次的预算, inputBuffer_中还有没处理的数据.
+         * 连接在本轮其他channel处理完之后再次执行消息回调, 不等待新的读事件, 避免一个连接的大量流水线命令阻塞其他连接.
+         * 暂停读取(超过高水位)期间不会继续, 恢复读取时继续 */
+        void deferMessage();
 
         /* 关闭连接 */
         void shutdown();
+        /* 不等待发送链发送完, 直接关闭连接 */
+        void forceClose();
+
+        /* 设置连接的channel为边沿触发(EPOLLET)，必须在connectEstablished之前调用 */
+        void setEdgeTriggered(bool on);
+
+        /* 设置连接所属loop的空闲连接时间轮，必须在connectEstablished之前调用 */
+        void setIdleWheel(const std::shared_ptr<TimingWheel>& wheel) {
+            assert(state_ == kConnecting);
+            idleWheel_ = wheel;
+        }
+
+        /* 设置连接所属loop的回复合并队列，之后send的数据在本轮beforeSleep阶段统一发送.
+         * 为空时每次send直接写socket，必须在connectEstablished之前调用 */
+        void setFlushQueue(const std::shared_ptr<FlushQueue>& queue) {
+            assert(state_ == kConnecting);
+            flushQueue_ = queue;
+        }
+
+        /* 不小于threshold字节的共享数据(如数据库中的大value)用MSG_ZEROCOPY发送, 0表示不使用.
+         * 发送之后数据由发送链持有, 直到内核在错误队列中通知发送完成. 必须在connectEstablished之前调用 */
+        void setZeroCopyThreshold(size_t threshold);
+
+        /* 上层保存在连接上的状态(如协议解析器)，连接放回ConnectionPool时清空 */
+        void setContext(const std::any& context) { context_ = context; }
+        const std::any& getContext() const { return context_; }
+        std::any* getMutableContext() { return &context_; }
+
+        /* 设置连接的SO_BUSY_POLL(微秒)，失败时返回false */
+        bool setBusyPoll(int usec) { return socket_->setBusyPoll(usec); }
 
         /*设置连接的网络套接字禁用 Nagle’s Algorithm， */
         void setTcpNoDelay(bool on);
@@ -78,6 +148,14 @@ namespace kvDB {
         void setKeepAlive(bool on);
 
     private:
+        friend class ConnectionPool;
+        friend class FlushQueue;
+
+        /* 从ConnectionPool中取出时，用新的连接重新初始化 */
+        void reset(uint64_t id, int sockfd, const InetAddress& localAddr, const InetAddress& peerAddr);
+        /* 放回ConnectionPool之前，关闭套接字并清空状态；channel还注册在Poller中时不能复用，返回false */
+        bool recycle();
+
         enum StateE{
             kConnecting,     // 正在建立Tcp连接
             kConnected,      // Tcp连接建立完成
@@ -86,22 +164,43 @@ namespace kvDB {
         };
 
         void setState(StateE s) { state_ = s; }
+        /* 边沿触发时一次读事件最多读取的字节数 */
+        static const size_t kMaxReadBytesPerEvent = 1024 * 1024;
+
         /* TcpConnection读事件到来时，处理读事件 */
         void handleRead(Timestamp receiveTime);
+        /* 边沿触发时处理读事件，在kMaxReadBytesPerEvent预算内读到EAGAIN */
+        void handleReadEdgeTriggered(Timestamp receiveTime);
         /* TcpConnection写事件到来时，处理写事件 */
         void handleWrite();
         /* 处理 TcpConnection关闭 */
         void handleClose();
         /* 处理 TcpConnection 错误 */
         void handleError();
-
-        void sendInLoop(const std::string & message);
+        /* deferMessage投递的回调, 对inputBuffer_中剩余的数据再执行一次消息回调 */
+        void handleDeferredMessage();
+        /* 读取socket错误队列中的零拷贝完成通知, 有通知时返回true */
+        bool readErrorQueue();
+
+        void sendInLoop(Slice&& slice);
+        void sendInLoop(OutputChain&& chain);
+        /* 数据已经挂到发送链上，登记到回复合并队列，在beforeSleep阶段发送 */
+        void deferFlush(size_t oldLen);
+        /* beforeSleep阶段由FlushQueue调用，发送发送链中积累的回复 */
+        void flushOutput();
+        /* 直接写socket出错时的处理, 返回是否是连接已经失效的错误 */
+        bool handleDirectWriteError(int savedErrno);
         void shutdownInLoop();
+        void forceCloseInLoop();
+        /* 发送链增长后检查硬上限和高水位, oldLen是增长前的字节数 */
+        void checkOutputGrown(size_t oldLen);
+        /* 发送链减少后检查低水位 */
+        void checkOutputDrained();
 
         EventLoop* loop_;
-        std::string name_;
-        StateE state_;
-        std::unique_ptr<Socket> socket_;
+        uint64_t id_;
+        std::atomic<StateE> state_;   // send/shutdown可能在其他线程中读取
+        std::optional<Socket> socket_;     // 对象被回收时关闭
         std::unique_ptr<Channel> channel_;
         InetAddress localAddr_;
         InetAddress peerAddr_;
@@ -110,9 +209,23 @@ namespace kvDB {
         MessageCallback       messageCallback_;
         WriteCompleteCallback writeCompleteCallback_;  // 写完成执行的回调
         CloseCallback         closeCallback_;
-
-        Buffer inputBuffer_;
-        Buffer outputBuffer_;
+        HighWaterMarkCallback highWaterMarkCallback_;
+        LowWaterMarkCallback  lowWaterMarkCallback_;
+        size_t highWaterMark_;
+        size_t lowWaterMark_;
+        size_t outputLimit_;
+
+        Buffer      inputBuffer_;
+        OutputChain outputChain_;  // 发送链, 没有发送完的数据片
+        bool   readPending_;   // 边沿触发时超过读取预算, 已投递继续读取的回调
+        bool   readingPaused_; // 发送链超过高水位, 暂停了读取
+        bool   flushPending_;  // 已经登记到回复合并队列, 等待beforeSleep阶段发送
+        bool   messagePending_; // 消息回调用完了预算, inputBuffer_中的数据等待继续处理
+
+        std::shared_ptr<TimingWheel> idleWheel_;  // 空闲连接时间轮, 没有设置空闲超时时为空
+        std::shared_ptr<FlushQueue> flushQueue_;  // 回复合并队列, 为空时直接发送
+        TimingWheel::Entry idleEntry_;            // 在时间轮中的节点
+        std::any context_;
     };
 }
 
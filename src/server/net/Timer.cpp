@@ -0,0 +1,24 @@
+/**
+  ******************************************************************************
+  * @file           : Timer.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-10
+  ******************************************************************************
+  */
+
+
+#include "Timer.h"
+
+namespace kvDB {
+    std::atomic<int64_t> Timer::s_numCreated_(0);
+
+    void Timer::restart(Timestamp now) {
+        if (repeat_) {
+            expiration_ = addTime(now, interval_);
+        } else {
+            expiration_ = Timestamp::invalid();
+        }
+    }
+}
@@ -0,0 +1,60 @@
+/**
+  ******************************************************************************
+  * @file           : Timer.h
+  * @author         : zgys
+  * @brief          : 定时器，保存到期时间、回调和重复间隔
+  * @attention      : None
+  * @date           : 23-4-10
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_TIMER_H
+#define KVDB_TIMER_H
+
+#include <atomic>
+#include "../comm/Noncopyable.h"
+#include "../comm/Timestamp.h"
+#include "Callbacks.h"
+
+namespace kvDB {
+    class Timer : Noncopyable {
+    public:
+        /**
+         * @brief 构造
+         * @param cb 到期执行的回调
+         * @param when 到期时间
+         * @param interval 重复间隔(秒)，大于0表示重复定时器
+         */
+        Timer(TimerCallback cb, Timestamp when, double interval)
+                : callback_(std::move(cb)),
+                  expiration_(when),
+                  interval_(interval),
+                  repeat_(interval > 0.0),
+                  sequence_(++s_numCreated_) {
+        }
+
+        /* 执行定时器回调 */
+        void run() const { callback_(); }
+
+        Timestamp expiration() const { return expiration_; }
+        bool repeat() const { return repeat_; }
+        int64_t sequence() const { return sequence_; }
+
+        /* 重复定时器从now开始计算下一次到期时间 */
+        void restart(Timestamp now);
+
+        static int64_t numCreated() { return s_numCreated_; }
+
+    private:
+        const TimerCallback callback_;
+        Timestamp           expiration_;   // 到期时间
+        const double        interval_;     // 重复间隔(秒)
+        const bool          repeat_;       // 是否重复
+        const int64_t       sequence_;     // 全局唯一的序号，区分地址相同的不同定时器
+
+        static std::atomic<int64_t> s_numCreated_;
+    };
+}
+
+#endif //KVDB_TIMER_H
@@ -0,0 +1,37 @@
+/**
+  ******************************************************************************
+  * @file           : TimerId.h
+  * @author         : zgys
+  * @brief          : 定时器的标识，用于取消定时器
+  * @attention      : None
+  * @date           : 23-4-10
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_TIMERID_H
+#define KVDB_TIMERID_H
+
+#include <cstdint>
+
+namespace kvDB {
+    class Timer;
+
+    class TimerId {
+    public:
+        TimerId() : timer_(nullptr), sequence_(0) {}
+
+        TimerId(Timer* timer, int64_t seq)
+                : timer_(timer),
+                  sequence_(seq) {
+        }
+
+        friend class TimerQueue;
+
+    private:
+        Timer*  timer_;
+        int64_t sequence_;
+    };
+}
+
+#endif //KVDB_TIMERID_H
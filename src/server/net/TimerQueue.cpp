@@ -0,0 +1,199 @@
+/**
+  ******************************************************************************
+  * @file           : TimerQueue.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-10
+  ******************************************************************************
+  */
+
+
+#include "TimerQueue.h"
+#include "Timer.h"
+#include "TimerId.h"
+#include "EventLoop.h"
+#include "../comm/Logger.h"
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cstring>
+#include <cassert>
+
+namespace kvDB {
+
+    int createTimerfd() {
+        int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timerfd < 0) {
+            LOG_FATAL("Failed in timerfd_create:%d\n", errno);
+        }
+        return timerfd;
+    }
+
+    /* 从现在到when的时间间隔, 最小100微秒, 避免设置为0导致timerfd被停止 */
+    struct timespec howMuchTimeFromNow(Timestamp when) {
+        int64_t microseconds = when.microSecondsSinceEpoch() - Timestamp::now().microSecondsSinceEpoch();
+        if (microseconds < 100) {
+            microseconds = 100;
+        }
+        struct timespec ts;
+        ts.tv_sec = static_cast<time_t>(microseconds / Timestamp::kMicroSecondsPerSecond);
+        ts.tv_nsec = static_cast<long>((microseconds % Timestamp::kMicroSecondsPerSecond) * 1000);
+        return ts;
+    }
+
+    /* 读掉timerfd的到期次数, 否则在LT模式下会一直触发 */
+    void readTimerfd(int timerfd) {
+        uint64_t howmany;
+        ssize_t n = ::read(timerfd, &howmany, sizeof howmany);
+        if (n != sizeof howmany) {
+            LOG_ERROR("TimerQueue::handleRead() reads %ld bytes instead of 8\n", n);
+        }
+    }
+
+    /* 将timerfd设置为在expiration时到期 */
+    void resetTimerfd(int timerfd, Timestamp expiration) {
+        struct itimerspec newValue;
+        struct itimerspec oldValue;
+        memset(&newValue, 0, sizeof newValue);
+        memset(&oldValue, 0, sizeof oldValue);
+        newValue.it_value = howMuchTimeFromNow(expiration);
+        if (::timerfd_settime(timerfd, 0, &newValue, &oldValue) != 0) {
+            LOG_ERROR("timerfd_settime error:%d\n", errno);
+        }
+    }
+
+    TimerQueue::TimerQueue(EventLoop* loop)
+            : loop_(loop),
+              timerfd_(createTimerfd()),
+              timerfdChannel_(loop, timerfd_),
+              callingExpiredTimers_(false) {
+        timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+        timerfdChannel_.enableReading();
+    }
+
+    TimerQueue::~TimerQueue() {
+        timerfdChannel_.disableAll();
+        timerfdChannel_.remove();
+        ::close(timerfd_);
+        for (const Entry& timer : timers_) {
+            delete timer.second;
+        }
+    }
+
+    TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval) {
+        auto* timer = new Timer(std::move(cb), when, interval);
+        loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
+        return TimerId(timer, timer->sequence());
+    }
+
+    void TimerQueue::cancel(TimerId timerId) {
+        loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
+    }
+
+    void TimerQueue::addTimerInLoop(Timer* timer) {
+        loop_->assertInLoopThread();
+        bool earliestChanged = insert(timer);
+        if (earliestChanged) {
+            resetTimerfd(timerfd_, timer->expiration());
+        }
+    }
+
+    void TimerQueue::cancelInLoop(TimerId timerId) {
+        loop_->assertInLoopThread();
+        assert(timers_.size() == activeTimers_.size());
+        ActiveTimer timer(timerId.timer_, timerId.sequence_);
+        auto it = activeTimers_.find(timer);
+        if (it != activeTimers_.end()) {
+            size_t n = timers_.erase(Entry(it->first->expiration(), it->first));
+            assert(n == 1);
+            (void) n;
+            delete it->first;
+            activeTimers_.erase(it);
+        } else if (callingExpiredTimers_) {
+            // 定时器已经到期并从timers_中移出, 正在执行回调(例如在自己的回调中取消自己)
+            cancelingTimers_.insert(timer);
+        }
+        assert(timers_.size() == activeTimers_.size());
+    }
+
+    void TimerQueue::handleRead() {
+        loop_->assertInLoopThread();
+        Timestamp now(Timestamp::now());
+        readTimerfd(timerfd_);
+
+        std::vector<Entry> expired = getExpired(now);
+
+        callingExpiredTimers_ = true;
+        cancelingTimers_.clear();
+        for (const Entry& it : expired) {
+            it.second->run();
+        }
+        callingExpiredTimers_ = false;
+
+        reset(expired, now);
+    }
+
+    std::vector<TimerQueue::Entry> TimerQueue::getExpired(Timestamp now) {
+        assert(timers_.size() == activeTimers_.size());
+        std::vector<Entry> expired;
+        /* 哨兵值: 比所有到期时间为now的定时器都大 */
+        Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));
+        auto end = timers_.lower_bound(sentry);
+        assert(end == timers_.end() || now < end->first);
+        std::copy(timers_.begin(), end, back_inserter(expired));
+        timers_.erase(timers_.begin(), end);
+
+        for (const Entry& it : expired) {
+            ActiveTimer timer(it.second, it.second->sequence());
+            size_t n = activeTimers_.erase(timer);
+            assert(n == 1);
+            (void) n;
+        }
+
+        assert(timers_.size() == activeTimers_.size());
+        return expired;
+    }
+
+    void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now) {
+        for (const Entry& it : expired) {
+            ActiveTimer timer(it.second, it.second->sequence());
+            if (it.second->repeat()
+                && cancelingTimers_.find(timer) == cancelingTimers_.end()) {
+                it.second->restart(now);
+                insert(it.second);
+            } else {
+                delete it.second;
+            }
+        }
+
+        if (!timers_.empty()) {
+            Timestamp nextExpire = timers_.begin()->second->expiration();
+            if (nextExpire.valid()) {
+                resetTimerfd(timerfd_, nextExpire);
+            }
+        }
+    }
+
+    bool TimerQueue::insert(Timer* timer) {
+        loop_->assertInLoopThread();
+        assert(timers_.size() == activeTimers_.size());
+        bool earliestChanged = false;
+        Timestamp when = timer->expiration();
+        auto it = timers_.begin();
+        if (it == timers_.end() || when < it->first) {
+            earliestChanged = true;
+        }
+        {
+            auto result = timers_.insert(Entry(when, timer));
+            assert(result.second);
+            (void) result;
+        }
+        {
+            auto result = activeTimers_.insert(ActiveTimer(timer, timer->sequence()));
+            assert(result.second);
+            (void) result;
+        }
+        assert(timers_.size() == activeTimers_.size());
+        return earliestChanged;
+    }
+}
@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file           : TimerQueue.h
+  * @author         : zgys
+  * @brief          : 基于timerfd的定时器队列，timerfd作为一个普通的Channel注册到EventLoop中，
+  *                   timerfd总是设置为最早到期的定时器的时间
+  * @attention      : 定时器按到期时间保存在std::set中，插入和取消都是O(log n)
+  * @date           : 23-4-10
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_TIMERQUEUE_H
+#define KVDB_TIMERQUEUE_H
+
+#include <set>
+#include <vector>
+#include "../comm/Noncopyable.h"
+#include "../comm/Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+
+namespace kvDB {
+    class EventLoop;
+    class Timer;
+    class TimerId;
+
+    class TimerQueue : Noncopyable {
+    public:
+        explicit TimerQueue(EventLoop* loop);
+        ~TimerQueue();
+
+        /* 添加定时器，在when时执行cb，interval大于0时每隔interval秒重复执行
+         * 可以在任意线程中调用 */
+        TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+
+        /* 取消定时器，可以在任意线程中调用 */
+        void cancel(TimerId timerId);
+
+    private:
+        /* first-->到期时间 second-->定时器，按到期时间排序，到期时间相同时按地址排序 */
+        using Entry = std::pair<Timestamp, Timer*>;
+        using TimerList = std::set<Entry>;
+        /* first-->定时器 second-->定时器的序号，按地址排序，用于取消定时器 */
+        using ActiveTimer = std::pair<Timer*, int64_t>;
+        using ActiveTimerSet = std::set<ActiveTimer>;
+
+        void addTimerInLoop(Timer* timer);
+        void cancelInLoop(TimerId timerId);
+
+        /* timerfd可读时的回调，执行所有到期的定时器 */
+        void handleRead();
+
+        /* 从timers_中移出所有到期的定时器 */
+        std::vector<Entry> getExpired(Timestamp now);
+
+        /* 重新插入到期的重复定时器，删除其余的定时器，重新设置timerfd */
+        void reset(const std::vector<Entry>& expired, Timestamp now);
+
+        /* 插入定时器，返回它是否成为最早到期的定时器 */
+        bool insert(Timer* timer);
+
+        EventLoop*     loop_;
+        const int      timerfd_;
+        Channel        timerfdChannel_;
+        TimerList      timers_;          // 按到期时间排序的定时器
+
+        ActiveTimerSet activeTimers_;    // 与timers_保存相同的定时器，按地址排序
+        bool           callingExpiredTimers_;
+        ActiveTimerSet cancelingTimers_; // 在到期回调中被取消的定时器，不再重新插入
+    };
+}
+
+#endif //KVDB_TIMERQUEUE_H
@@ -0,0 +1,109 @@
+/**
+  ******************************************************************************
+  * @file           : TimingWheel.cpp
+  * @author         : zgys
+  * @brief          : None
+  * @attention      : None
+  * @date           : 23-4-18
+  ******************************************************************************
+  */
+
+
+#include "TimingWheel.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "../comm/Logger.h"
+
+#include <cmath>
+
+namespace kvDB {
+    TimingWheel::TimingWheel(EventLoop* loop, double idleSeconds, double tickSeconds)
+            : loop_(loop),
+              tickSeconds_(tickSeconds),
+              timeoutTicks_(static_cast<uint64_t>(std::ceil(idleSeconds / tickSeconds))),
+              currentTick_(0),
+              size_(0),
+              buckets_(timeoutTicks_ + 2, Entry(nullptr)) {
+        assert(timeoutTicks_ > 0);
+        for (Entry& head : buckets_) {
+            head.prev = &head;
+            head.next = &head;
+        }
+    }
+
+    void TimingWheel::start() {
+        /* 定时器只持有弱引用，Server析构后定时器回调什么也不做 */
+        std::weak_ptr<TimingWheel> weakWheel(shared_from_this());
+        timerId_ = loop_->runEvery(tickSeconds_, [weakWheel]() {
+            if (auto wheel = weakWheel.lock()) {
+                wheel->onTick();
+            }
+        });
+    }
+
+    void TimingWheel::stop() {
+        loop_->cancel(timerId_);
+    }
+
+    void TimingWheel::add(Entry* entry) {
+        loop_->assertInLoopThread();
+        assert(!entry->linked());
+        entry->lastActive = currentTick_;
+        link(entry, expireTick(entry));
+        ++size_;
+    }
+
+    void TimingWheel::remove(Entry* entry) {
+        loop_->assertInLoopThread();
+        if (entry->linked()) {
+            unlink(entry);
+            --size_;
+        }
+    }
+
+    void TimingWheel::onTick() {
+        loop_->assertInLoopThread();
+        ++currentTick_;
+        Entry& head = buckets_[currentTick_ % buckets_.size()];
+        if (head.next == &head) {
+            return;
+        }
+
+        /* 先把整个格子摘下来，避免处理时挂回的节点被重复处理 */
+        Entry pending(nullptr);
+        pending.next = head.next;
+        pending.prev = head.prev;
+        pending.next->prev = &pending;
+        pending.prev->next = &pending;
+        head.prev = &head;
+        head.next = &head;
+
+        while (pending.next != &pending) {
+            Entry* entry = pending.next;
+            unlink(entry);
+            const uint64_t expire = expireTick(entry);
+            if (expire > currentTick_) {
+                link(entry, expire);
+            } else {
+                --size_;
+                LOG_INFO("TimingWheel close idle connection [%s].\n", entry->owner->name().c_str());
+                entry->owner->forceClose();
+            }
+        }
+    }
+
+    void TimingWheel::link(Entry* entry, uint64_t expireTick) {
+        Entry& head = buckets_[expireTick % buckets_.size()];
+        entry->prev = head.prev;
+        entry->next = &head;
+        head.prev->next = entry;
+        head.prev = entry;
+    }
+
+    void TimingWheel::unlink(Entry* entry) {
+        entry->prev->next = entry->next;
+        entry->next->prev = entry->prev;
+        entry->prev = nullptr;
+        entry->next = nullptr;
+    }
+}
@@ -0,0 +1,87 @@
+/**
+  ******************************************************************************
+  * @file           : TimingWheel.h
+  * @author         : zgys
+  * @brief          : 关闭空闲连接的时间轮，每个EventLoop一个
+  * @attention      : 只能在所属loop的线程中使用
+  * @date           : 23-4-18
+  ******************************************************************************
+  */
+
+
+#ifndef KVDB_TIMINGWHEEL_H
+#define KVDB_TIMINGWHEEL_H
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "TimerId.h"
+#include "../comm/Noncopyable.h"
+
+namespace kvDB {
+    class EventLoop;
+    class TcpConnection;
+
+    /* 哈希时间轮: 轮上有 timeoutTicks+2 个格子，每个格子是一个侵入式双向链表.
+     * 连接按 最后活跃的tick + timeoutTicks + 1 放进对应的格子(最后活跃的tick只过去了一部分，从下一个tick开始计时，
+     * 保证空闲时间不少于设置的时间，最多多出一个tick)；有读事件时touch只更新最后活跃的tick，
+     * 不移动节点也不分配内存. 每个tick只处理当前格子里的连接: 已经超时的关闭，
+     * 期间活跃过的按新的过期tick挂到对应的格子，所以每个连接每个超时周期最多被处理一次 */
+    class TimingWheel : Noncopyable, public std::enable_shared_from_this<TimingWheel> {
+    public:
+        /* 嵌入在TcpConnection中的链表节点 */
+        struct Entry {
+            explicit Entry(TcpConnection* conn) : prev(nullptr), next(nullptr), lastActive(0), owner(conn) {}
+
+            bool linked() const { return next != nullptr; }
+
+            Entry* prev;
+            Entry* next;
+            uint64_t lastActive;    // 最后活跃的tick
+            TcpConnection* owner;
+        };
+
+        /**
+         * @brief 构造
+         * @param loop 时间轮所属的循环
+         * @param idleSeconds 连接空闲超过这个时间就关闭
+         * @param tickSeconds 时间轮转动的间隔，也是超时的精度
+         */
+        TimingWheel(EventLoop* loop, double idleSeconds, double tickSeconds = 1.0);
+        ~TimingWheel() = default;
+
+        /* 启动/停止转动时间轮的定时器，可以在任意线程中调用 */
+        void start();
+        void stop();
+
+        /* 连接建立时加入时间轮 */
+        void add(Entry* entry);
+        /* 连接关闭时从时间轮中移除，没有加入时什么也不做 */
+        void remove(Entry* entry);
+        /* 连接有读事件，O(1)且不分配内存 */
+        void touch(Entry* entry) { entry->lastActive = currentTick_; }
+
+        /* 时间轮中的连接数 */
+        size_t size() const { return size_; }
+
+    private:
+        /* 定时器回调，转动一格 */
+        void onTick();
+        /* entry的过期tick */
+        uint64_t expireTick(const Entry* entry) const { return entry->lastActive + timeoutTicks_ + 1; }
+
+        /* 把entry挂到它的过期tick对应的格子 */
+        void link(Entry* entry, uint64_t expireTick);
+        static void unlink(Entry* entry);
+
+        EventLoop* loop_;
+        const double tickSeconds_;
+        const uint64_t timeoutTicks_;
+        uint64_t currentTick_;
+        size_t size_;
+        std::vector<Entry> buckets_;   // 每个格子链表的哨兵节点
+        TimerId timerId_;
+    };
+}
+
+#endif //KVDB_TIMINGWHEEL_H
@@ -0,0 +1,148 @@
+/**
+  ******************************************************************************
+  * @file           : bench_churn.cpp
+  * @author         : zgys
+  * @brief          : 短连接负载: 每个客户端反复 连接->一次请求->关闭，统计每秒处理的连接数;
+  *                    之后模拟重连风暴: 同时建立kBurst个连接，统计全部得到回复的时间和accept统计
+  * @attention      : 用法: bench_churn [端口] [io线程数] [epoll|io_uring] [accept预算]
+  * @date           : 23-4-19
+  ******************************************************************************
+  */
+
+#include "./src/server/net/Server.h"
+#include "./src/server/net/EventLoopThread.h"
+#include "./src/server/net/Poller.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+using namespace kvDB;
+
+static const int kClients     = 4;      // 并发的客户端数
+static const int kConnections = 20000;  // 每个客户端建立的连接数
+static const int kBurst       = 2000;   // 重连风暴中同时建立的连接数
+
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    const char* crlf = buf->findCRLF();
+    if (crlf != nullptr) {
+        buf->retrieve(crlf + 2 - buf->peek());
+        conn->send(std::string("+PONG\r\n"));
+    }
+}
+
+void runClient(uint16_t port, std::atomic<int>* failed) {
+    sockaddr_in addr = InetAddress(port).getSockAddr();
+    char buf[64];
+    for (int i = 0; i < kConnections; ++i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0
+            || ::write(fd, "PING\r\n", 6) != 6
+            || ::read(fd, buf, sizeof buf) <= 0) {
+            ++*failed;
+        }
+        /* SO_LINGER 0 直接发送RST，避免客户端端口耗尽在TIME_WAIT */
+        linger lg{1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof lg);
+        ::close(fd);
+    }
+}
+
+/* 先建立全部连接(握手由内核完成，连接在backlog中等待accept)，再逐个请求 */
+int runBurst(uint16_t port, std::atomic<bool>* connected) {
+    sockaddr_in addr = InetAddress(port).getSockAddr();
+    std::vector<int> fds;
+    int failed = 0;
+    for (int i = 0; i < kBurst; ++i) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0
+            || ::write(fd, "PING\r\n", 6) != 6) {
+            ++failed;
+        }
+        fds.push_back(fd);
+    }
+    *connected = true;
+    char buf[64];
+    for (int fd : fds) {
+        if (::read(fd, buf, sizeof buf) <= 0) {
+            ++failed;
+        }
+        linger lg{1, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof lg);
+        ::close(fd);
+    }
+    return failed;
+}
+
+int main(int argc, char** argv) {
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 19991;
+    int threads = argc > 2 ? atoi(argv[2]) : 0;
+    bool ioUring = argc > 3 && strcmp(argv[3], "io_uring") == 0;
+    int budget = argc > 4 ? atoi(argv[4]) : 64;
+    Poller::setDefaultBackend(ioUring ? Poller::kIoUring : Poller::kEpoll);
+
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    std::unique_ptr<Server> server;
+    std::atomic<bool> ready(false);
+    loop->runInLoop([&]() {
+        server.reset(new Server(loop, InetAddress(port), "churn"));
+        server->setThreadNum(threads);
+        server->setAcceptBudget(budget);
+        server->setListenBacklog(kBurst * 2);
+        server->setConnectionCallback([](const TcpConnectionPtr&) {});
+        server->setMessageCallback(onMessage);
+        server->start();
+        ready = true;
+    });
+    while (!ready) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::atomic<int> failed(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (int i = 0; i < kClients; ++i) {
+        clients.emplace_back(runClient, port, &failed);
+    }
+    for (auto& t : clients) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%s io-threads %d: %d connections in %.2fs, %.0f conn/s, %d failed\n",
+           ioUring ? "io_uring" : "epoll", threads, kClients * kConnections, seconds, kClients * kConnections / seconds, failed.load());
+
+    /* baseLoop阻塞到所有连接都进入backlog，模拟部署后的重连风暴 */
+    std::atomic<bool> connected(false);
+    loop->runInLoop([&]() {
+        while (!connected) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+    start = std::chrono::steady_clock::now();
+    int burstFailed = runBurst(port, &connected);
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("burst of %d connections served in %.3fs, %d failed\n", kBurst, seconds, burstFailed);
+
+    std::atomic<bool> done(false);
+    loop->runInLoop([&]() {
+        Acceptor::Stats stats = server->acceptStats();
+        printf("accept budget %d: %lu connections in %lu wakeups, %.2f per wakeup, max %lu, budget exhausted %lu\n",
+               budget, stats.accepted, stats.wakeups, static_cast<double>(stats.accepted) / static_cast<double>(stats.wakeups),
+               stats.maxPerWakeup, stats.budgetExhausted);
+        server.reset();
+        done = true;
+    });
+    while (!done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return 0;
+}
@@ -0,0 +1,145 @@
+/**
+  ******************************************************************************
+  * @file           : bench_fairness.cpp
+  * @author         : zgys
+  * @brief          : 一个连接发送很长的流水线时，其他连接的请求延迟: 对比不限制和限制每次读事件执行的命令数
+  * @attention      : 用法: bench_fairness [端口]
+  * @date           : 23-4-22
+  ******************************************************************************
+  */
+
+#include "./src/server/net/Server.h"
+#include "./src/server/net/EventLoopThread.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+using namespace kvDB;
+
+static const int kHogPipeline = 20000;  // 占用连接每批发送的请求数
+static const int kHogBatches  = 20;     // 占用连接发送的批数
+
+static size_t g_budget = 0;   // 每次消息回调最多执行的命令数, 0表示不限制
+
+/* 每一行是一个请求, 模拟每条命令1微秒的执行时间 */
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    size_t commands = 0;
+    const char* crlf;
+    while ((crlf = buf->findCRLF()) != nullptr) {
+        if (g_budget > 0 && commands == g_budget) {
+            conn->deferMessage();
+            return;
+        }
+        buf->retrieve(crlf + 2 - buf->peek());
+        auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(1);
+        while (std::chrono::steady_clock::now() < until) {
+        }
+        conn->send(Slice::fromStatic("+OK\r\n", 5));
+        ++commands;
+    }
+}
+
+int connectTo(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = InetAddress(port).getSockAddr();
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) {
+        perror("connect");
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+    return fd;
+}
+
+void runHog(uint16_t port, std::atomic<bool>* done) {
+    int fd = connectTo(port);
+    std::string batch;
+    for (int i = 0; i < kHogPipeline; ++i) {
+        batch.append("PING\r\n");
+    }
+    const size_t expect = kHogPipeline * 5;
+    char buf[65536];
+    for (int i = 0; i < kHogBatches; ++i) {
+        /* 边写边读, 避免双方的发送缓冲区都满了 */
+        size_t written = 0;
+        size_t got = 0;
+        while (got < expect) {
+            if (written < batch.size()) {
+                ssize_t n = ::send(fd, batch.data() + written, batch.size() - written, MSG_DONTWAIT);
+                if (n > 0) {
+                    written += static_cast<size_t>(n);
+                }
+            }
+            ssize_t n = ::recv(fd, buf, sizeof buf, written < batch.size() ? MSG_DONTWAIT : 0);
+            if (n == 0) {
+                break;
+            }
+            if (n > 0) {
+                got += static_cast<size_t>(n);
+            }
+        }
+    }
+    ::close(fd);
+    *done = true;
+}
+
+void bench(size_t budget, uint16_t port) {
+    g_budget = budget;
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    std::unique_ptr<Server> server;
+    std::atomic<bool> ready(false);
+    loop->runInLoop([&]() {
+        server.reset(new Server(loop, InetAddress(port), "fairness"));
+        server->setConnectionCallback([](const TcpConnectionPtr&) {});
+        server->setMessageCallback(onMessage);
+        server->start();
+        ready = true;
+    });
+    while (!ready) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::atomic<bool> done(false);
+    std::thread hog(runHog, port, &done);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    /* 占用连接发送期间一直探测 */
+    int fd = connectTo(port);
+    std::vector<double> latencies;
+    char buf[64];
+    while (!done) {
+        auto start = std::chrono::steady_clock::now();
+        if (::write(fd, "PING\r\n", 6) != 6 || ::read(fd, buf, sizeof buf) <= 0) {
+            break;
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+    }
+    ::close(fd);
+    hog.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    if (!latencies.empty()) {
+        printf("budget %-9s %6zu probes, latency p50 %6.0f us  p99 %6.0f us  p99.9 %6.0f us  max %6.0f us\n",
+               budget == 0 ? "unlimited" : std::to_string(budget).c_str(), latencies.size(),
+               latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100],
+               latencies[latencies.size() * 999 / 1000], latencies.back());
+    }
+
+    loop->runInLoop([&]() { server.reset(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+int main(int argc, char** argv) {
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 19971;
+    bench(0, port);
+    bench(64, static_cast<uint16_t>(port + 1));
+    return 0;
+}
@@ -0,0 +1,134 @@
+/**
+  ******************************************************************************
+  * @file           : bench_pipeline.cpp
+  * @author         : zgys
+  * @brief          : 流水线负载下水平触发与边沿触发、epoll与io_uring的对比，
+  *                   统计吞吐和每千个请求的poll次数(epoll_wait或io_uring_enter);
+  *                   以及每个请求单独send时，合并回复(beforeSleep阶段统一发送)与直接发送的对比
+  * @attention      : 完整的系统调用统计可以用 strace -c -f ./bench_pipeline 得到
+  * @date           : 23-4-12
+  ******************************************************************************
+  */
+
+#include "./src/server/net/Server.h"
+#include "./src/server/net/EventLoopThread.h"
+#include "./src/server/net/Poller.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+using namespace kvDB;
+
+static const int kClients   = 8;      // 客户端连接数
+static const int kPipeline  = 64;     // 每批流水线发送的请求数
+static const int kBatches   = 2000;   // 每个连接发送的批数
+
+/* 每一行是一个请求, 每个请求回复 "+OK\r\n" */
+void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    std::string reply;
+    const char* crlf;
+    while ((crlf = buf->findCRLF()) != nullptr) {
+        buf->retrieve(crlf + 2 - buf->peek());
+        reply.append("+OK\r\n");
+    }
+    if (!reply.empty()) {
+        conn->send(std::move(reply));
+    }
+}
+
+/* 每个请求单独send一次回复，合并回复关闭时每个请求一次write */
+void onMessagePerCommand(const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+    const char* crlf;
+    while ((crlf = buf->findCRLF()) != nullptr) {
+        buf->retrieve(crlf + 2 - buf->peek());
+        conn->send(Slice::fromStatic("+OK\r\n", 5));
+    }
+}
+
+void runClient(uint16_t port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = InetAddress(port).getSockAddr();
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) {
+        perror("connect");
+        return;
+    }
+    std::string batch;
+    for (int i = 0; i < kPipeline; ++i) {
+        batch.append("PING\r\n");
+    }
+    const size_t expect = kPipeline * 5;
+    char buf[65536];
+    for (int i = 0; i < kBatches; ++i) {
+        ::write(fd, batch.data(), batch.size());
+        size_t got = 0;
+        while (got < expect) {
+            ssize_t n = ::read(fd, buf, sizeof buf);
+            if (n <= 0) {
+                ::close(fd);
+                return;
+            }
+            got += static_cast<size_t>(n);
+        }
+    }
+    ::close(fd);
+}
+
+void bench(Poller::Backend backend, bool edgeTriggered, uint16_t port,
+           bool perCommand = false, bool coalesce = true) {
+    Poller::setDefaultBackend(backend);
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    std::unique_ptr<Server> server;
+    std::atomic<bool> ready(false);
+    loop->runInLoop([&]() {
+        server.reset(new Server(loop, InetAddress(port), "bench"));
+        server->setEdgeTriggered(edgeTriggered);
+        server->setCoalesceReplies(coalesce);
+        server->setConnectionCallback([](const TcpConnectionPtr&) {});
+        server->setMessageCallback(perCommand ? onMessagePerCommand : onMessage);
+        server->start();
+        ready = true;
+    });
+    while (!ready) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    int64_t startIteration = loop->iteration();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (int i = 0; i < kClients; ++i) {
+        clients.emplace_back(runClient, port);
+    }
+    for (auto& t : clients) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    int64_t iterations = loop->iteration() - startIteration;
+
+    double requests = static_cast<double>(kClients) * kPipeline * kBatches;
+    printf("%-8s %-15s %-22s %10.0f req/s  %8ld polls  %6.2f polls per 1k req\n",
+           backend == Poller::kIoUring ? "io_uring" : "epoll",
+           edgeTriggered ? "edge-triggered" : "level-triggered",
+           perCommand ? (coalesce ? "per-command coalesced" : "per-command direct") : "batched by handler",
+           requests / seconds, iterations, iterations * 1000.0 / requests);
+
+    loop->runInLoop([&]() { server.reset(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+int main(int argc, char** argv) {
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 19981;
+    bench(Poller::kEpoll, false, port);
+    bench(Poller::kEpoll, true, static_cast<uint16_t>(port + 1));
+    bench(Poller::kIoUring, false, static_cast<uint16_t>(port + 2));
+    bench(Poller::kIoUring, true, static_cast<uint16_t>(port + 3));
+    bench(Poller::kEpoll, false, static_cast<uint16_t>(port + 4), true, false);
+    bench(Poller::kEpoll, false, static_cast<uint16_t>(port + 5), true, true);
+    return 0;
+}
@@ -0,0 +1,179 @@
+/**
+  ******************************************************************************
+  * @file           : bench_resp.cpp
+  * @author         : zgys
+  * @brief          : RESP增量解析的吞吐: 流水线请求一次整块到达，以及被切成随机大小的小段分多次到达;
+  *                   以及回复按RESP2/RESP3编码的吞吐
+  * @attention      : 用法 bench_resp [参数大小] [请求数]，先检查解析器的边界情况，两种到达方式解析出的请求
+  *                   必须相同，任何一项不符时返回非0
+  * @date           : 23-4-29
+  ******************************************************************************
+  */
+
+#include "./src/server/RespParser.h"
+#include "./src/server/Reply.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace kvDB;
+
+static std::string encode(const std::vector<std::string>& argv) {
+    std::string out = "*" + std::to_string(argv.size()) + "\r\n";
+    for (const std::string& arg : argv) {
+        out += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    }
+    return out;
+}
+
+/* 把stream按chunks切分后依次追加到Buffer中解析，返回解析出的请求数和参数总字节数 */
+static bool parseAll(const std::string& stream, const std::vector<size_t>& chunks,
+                     size_t* requests, size_t* argBytes) {
+    Buffer buf;
+    RespParser parser;
+    CommandArgs argv;
+    size_t offset = 0;
+    for (size_t chunk : chunks) {
+        buf.append(stream.data() + offset, chunk);
+        offset += chunk;
+        while (buf.readableBytes() > 0) {
+            size_t frameLen = 0;
+            RespParser::Result res = parser.parse(&buf, &argv, &frameLen);
+            if (res == RespParser::kIncomplete) {
+                break;
+            }
+            if (res == RespParser::kError) {
+                printf("parse error: %s\n", parser.error().c_str());
+                return false;
+            }
+            ++*requests;
+            for (const std::string_view& arg : argv) {
+                *argBytes += arg.size();
+            }
+            buf.retrieve(frameLen);
+        }
+    }
+    return buf.readableBytes() == 0;
+}
+
+/* 单独解析一段输入，检查结果、参数个数和错误原因 */
+static bool expectParse(const char* name, const std::string& input, RespParser::Result expect,
+                        size_t expectArgs = 0, const std::string& expectError = "") {
+    Buffer buf;
+    buf.append(input.data(), input.size());
+    RespParser parser;
+    CommandArgs argv;
+    size_t frameLen = 0;
+    RespParser::Result res = parser.parse(&buf, &argv, &frameLen);
+    bool ok = res == expect;
+    if (ok && res == RespParser::kComplete) {
+        ok = argv.size() == expectArgs && frameLen == input.size();
+    }
+    if (ok && res == RespParser::kError && !expectError.empty()) {
+        ok = parser.error() == expectError;
+    }
+    if (!ok) {
+        printf("edge case %-28s MISMATCH (result %d, %zu args, error '%s')\n", name, static_cast<int>(res),
+               argv.size(), parser.error().c_str());
+    }
+    return ok;
+}
+
+static bool checkEdgeCases() {
+    const std::string maxMultibulk = std::to_string(RespParser::kMaxMultibulkLen);
+    const std::string maxBulk = std::to_string(RespParser::kMaxBulkLen);
+    bool ok = true;
+    ok &= expectParse("*0", "*0\r\n", RespParser::kComplete, 0);
+    ok &= expectParse("*-1", "*-1\r\n", RespParser::kComplete, 0);
+    ok &= expectParse("empty bulk", "*1\r\n$0\r\n\r\n", RespParser::kComplete, 1);
+    ok &= expectParse("$-1", "*1\r\n$-1\r\n", RespParser::kError, 0, "invalid bulk length");
+    ok &= expectParse("negative bulk length", "*2\r\n$3\r\nGET\r\n$-7\r\n", RespParser::kError, 0,
+                      "invalid bulk length");
+    ok &= expectParse("oversized multibulk", "*" + std::to_string(RespParser::kMaxMultibulkLen + 1) + "\r\n",
+                      RespParser::kError, 0, "invalid multibulk length");
+    ok &= expectParse("max multibulk", "*" + maxMultibulk + "\r\n", RespParser::kIncomplete);
+    ok &= expectParse("oversized bulk", "*1\r\n$" + std::to_string(RespParser::kMaxBulkLen + 1) + "\r\n",
+                      RespParser::kError, 0, "invalid bulk length");
+    ok &= expectParse("max bulk", "*1\r\n$" + maxBulk + "\r\n", RespParser::kIncomplete);
+    ok &= expectParse("overflowing length", "*1\r\n$99999999999999999999999\r\n", RespParser::kError);
+    ok &= expectParse("non-digit length", "*1x\r\n", RespParser::kError, 0, "invalid length");
+    ok &= expectParse("empty length", "*\r\n", RespParser::kError, 0, "invalid length");
+    ok &= expectParse("wrong prefix", "*1\r\n:3\r\n", RespParser::kError);
+    ok &= expectParse("missing CRLF after bulk", "*1\r\n$3\r\nGETxx", RespParser::kError, 0,
+                      "bulk not terminated by CRLF");
+    ok &= expectParse("bulk waiting for CRLF", "*1\r\n$3\r\nGET", RespParser::kIncomplete);
+    ok &= expectParse("too long length line", "*" + std::string(RespParser::kMaxLineLen + 1, '1'),
+                      RespParser::kError, 0, "too big length line");
+    ok &= expectParse("binary bulk", std::string("*1\r\n$4\r\n\r\n\0x\r\n", 14), RespParser::kComplete, 1);
+    printf("edge cases %s\n", ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+static bool benchParse(const std::string& stream, const std::vector<size_t>& chunks, const char* name,
+                       size_t expectRequests) {
+    size_t requests = 0;
+    size_t argBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    bool ok = parseAll(stream, chunks, &requests, &argBytes);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ok = ok && requests == expectRequests;
+    printf("parse %-14s %6zu reads  %10.0f req/s  %8.1f MB/s  %s\n", name, chunks.size(),
+           static_cast<double>(requests) / seconds,
+           static_cast<double>(stream.size()) / seconds / (1024 * 1024), ok ? "ok" : "MISMATCH");
+    return ok;
+}
+
+static void benchEncode(int protover, int count) {
+    auto value = std::make_shared<const std::string>(4096, 'v');
+    size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        OutputChain out;
+        std::vector<Reply> fields;
+        for (int j = 0; j < 8; ++j) {
+            fields.push_back(Reply::bulk("field" + std::to_string(j)));
+            fields.push_back(Reply::bulk(value));
+        }
+        Reply::map(std::move(fields)).appendResp(&out, protover);
+        Reply::integer(i).appendResp(&out, protover);
+        Reply::nil().appendResp(&out, protover);
+        bytes += out.readableBytes();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("encode RESP%d   %10.0f replies/s  %8.1f MB/s\n", protover,
+           3.0 * count / seconds, static_cast<double>(bytes) / seconds / (1024 * 1024));
+}
+
+int main(int argc, char** argv) {
+    size_t argSize = argc > 1 ? static_cast<size_t>(atol(argv[1])) : 64;
+    int count = argc > 2 ? atoi(argv[2]) : 200000;
+    bool ok = checkEdgeCases();
+
+    std::string stream;
+    std::string value(argSize, 'v');
+    for (int i = 0; i < count; ++i) {
+        stream += encode({"SET", "key:" + std::to_string(i), value});
+    }
+
+    std::vector<size_t> whole = {stream.size()};
+    ok &= benchParse(stream, whole, "one read", static_cast<size_t>(count));
+
+    /* 每次读到1~4096字节，帧的任意位置都可能被切开 */
+    std::mt19937 rng(20230429);
+    std::uniform_int_distribution<size_t> dist(1, 4096);
+    std::vector<size_t> chunks;
+    for (size_t left = stream.size(); left > 0;) {
+        size_t chunk = std::min(dist(rng), left);
+        chunks.push_back(chunk);
+        left -= chunk;
+    }
+    ok &= benchParse(stream, chunks, "random split", static_cast<size_t>(count));
+
+    benchEncode(2, count / 10);
+    benchEncode(3, count / 10);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/**
+  ******************************************************************************
+  * @file           : bench_threaded_io.cpp
+  * @author         : zgys
+  * @brief          : 大回复的GET负载下，subLoop加锁执行命令与threaded-io(subLoop只读写，baseLoop串行执行)的对比;
+  *                   以及多个线程同时queueInLoop时的投递吞吐
+  * @attention      : 用法 bench_threaded_io [port] [io线程数] [回复大小]
+  * @date           : 23-4-27
+  ******************************************************************************
+  */
+
+#include "./src/server/net/Server.h"
+#include "./src/server/net/EventLoopThread.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+using namespace kvDB;
+
+static const int kClients   = 8;      // 客户端连接数
+static const int kPipeline  = 16;     // 每批流水线发送的GET数
+static const int kBatches   = 500;    // 每个连接发送的批数
+static const int kProducers = 4;      // 投递回调的线程数
+static const int kPosts     = 200000; // 每个线程投递的回调数
+
+/* 模拟数据库: 一个key对应一个大value, 回复共享value不拷贝 */
+struct Store {
+    std::unordered_map<std::string, std::shared_ptr<const std::string>> dict;
+    std::mutex mutex;   // 加锁模式下多个subLoop并发执行时使用
+};
+
+void runClient(uint16_t port, size_t valueSize) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = InetAddress(port).getSockAddr();
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) {
+        perror("connect");
+        return;
+    }
+    std::string batch;
+    for (int i = 0; i < kPipeline; ++i) {
+        batch.append("GET k\r\n");
+    }
+    const size_t expect = kPipeline * valueSize;
+    std::vector<char> buf(1 << 20);
+    for (int i = 0; i < kBatches; ++i) {
+        ::write(fd, batch.data(), batch.size());
+        size_t got = 0;
+        while (got < expect) {
+            ssize_t n = ::read(fd, buf.data(), buf.size());
+            if (n <= 0) {
+                ::close(fd);
+                return;
+            }
+            got += static_cast<size_t>(n);
+        }
+    }
+    ::close(fd);
+}
+
+/* 切出buf中完整的命令行 */
+std::vector<std::string> frame(Buffer* buf) {
+    std::vector<std::string> commands;
+    const char* crlf;
+    while ((crlf = buf->findCRLF()) != nullptr) {
+        commands.emplace_back(buf->peek() + 4, crlf);   // 跳过 "GET "
+        buf->retrieve(crlf + 2 - buf->peek());
+    }
+    return commands;
+}
+
+void bench(uint16_t port, int ioThreads, size_t valueSize, bool threadedIo) {
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    std::unique_ptr<Server> server;
+    Store store;
+    store.dict["k"] = std::make_shared<const std::string>(valueSize, 'v');
+    std::atomic<bool> ready(false);
+    loop->runInLoop([&]() {
+        server.reset(new Server(loop, InetAddress(port), "bench"));
+        server->setThreadNum(ioThreads);
+        server->setConnectionCallback([](const TcpConnectionPtr&) {});
+        if (threadedIo) {
+            /* subLoop切分命令, baseLoop不加锁地执行, 回复交回subLoop发送 */
+            server->setMessageCallback([&store, loop](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+                std::vector<std::string> commands = frame(buf);
+                if (commands.empty()) {
+                    return;
+                }
+                loop->queueInLoop([&store, conn, commands = std::move(commands)]() {
+                    std::vector<std::shared_ptr<const std::string>> replies;
+                    replies.reserve(commands.size());
+                    for (const std::string& key : commands) {
+                        replies.push_back(store.dict[key]);
+                    }
+                    conn->getLoop()->queueInLoop([conn, replies = std::move(replies)]() {
+                        for (const auto& reply : replies) {
+                            conn->send(reply);
+                        }
+                    });
+                });
+            });
+        } else {
+            /* subLoop加全局锁执行命令并直接发送 */
+            server->setMessageCallback([&store](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+                for (const std::string& key : frame(buf)) {
+                    std::shared_ptr<const std::string> reply;
+                    {
+                        std::lock_guard<std::mutex> lock(store.mutex);
+                        reply = store.dict[key];
+                    }
+                    conn->send(reply);
+                }
+            });
+        }
+        server->start();
+        ready = true;
+    });
+    while (!ready) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (int i = 0; i < kClients; ++i) {
+        clients.emplace_back(runClient, port, valueSize);
+    }
+    for (auto& t : clients) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double requests = static_cast<double>(kClients) * kPipeline * kBatches;
+    printf("%-24s io-threads %d  value %6zu  %10.0f req/s  %8.1f MB/s\n",
+           threadedIo ? "threaded-io" : "locked execution", ioThreads, valueSize,
+           requests / seconds, requests * static_cast<double>(valueSize) / seconds / (1024 * 1024));
+
+    /* 等客户端关闭的连接在baseLoop中移除完，再析构Server */
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    loop->runInLoop([&]() { server.reset(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+/* kProducers个线程同时向一个loop投递回调, loop线程执行, 统计每秒投递的回调数 */
+void benchQueueInLoop() {
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    std::atomic<int64_t> executed(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    for (int i = 0; i < kProducers; ++i) {
+        producers.emplace_back([loop, &executed]() {
+            for (int j = 0; j < kPosts; ++j) {
+                loop->queueInLoop([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    const int64_t total = static_cast<int64_t>(kProducers) * kPosts;
+    while (executed.load() < total) {
+        std::this_thread::yield();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("queueInLoop: %d producers  %10.0f posts/s\n", kProducers, static_cast<double>(total) / seconds);
+}
+
+int main(int argc, char** argv) {
+    uint16_t port = argc > 1 ? static_cast<uint16_t>(atoi(argv[1])) : 19981;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 4;
+    size_t valueSize = argc > 3 ? static_cast<size_t>(atol(argv[3])) : 16 * 1024;
+    bench(port, ioThreads, valueSize, false);
+    bench(static_cast<uint16_t>(port + 1), ioThreads, valueSize, true);
+    benchQueueInLoop();
+    return 0;
+}
@@ -0,0 +1,277 @@
+/**
+  ******************************************************************************
+  * @file           : test_rdb.cpp
+  * @author         : zgys
+  * @brief          : rdb持久化的往返检查: 通过RESP写入各种类型的二进制数据(含\0、\r\n、空串和大value)
+  *                   和非整数的zset分值，rdbSave之后用Database::rdbLoad重新载入并逐项比较;
+  *                   以及旧的KV0001格式文件的载入
+  * @attention      : 用法 test_rdb [port]，在临时目录中运行，任何一项不符时返回非0
+  * @date           : 23-4-30
+  ******************************************************************************
+  */
+
+#include "./src/server/DBServer.h"
+#include "./src/server/db/DBObj.h"
+
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+using namespace kvDB;
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        ++failures;
+    }
+}
+
+static std::string encode(const std::vector<std::string>& argv) {
+    std::string out = "*" + std::to_string(argv.size()) + "\r\n";
+    for (const std::string& arg : argv) {
+        out += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    }
+    return out;
+}
+
+static const std::string kNulKey("key\0with\0nul", 12);
+static const std::string kNulValue("\0\0value\0", 8);
+static const std::string kCrlfKey = "key\r\nwith crlf";
+static const std::string kCrlfValue = "*1\r\n$3\r\nSD0\nST!#$^EOF\r\n";
+
+/* zset的成员和分值，按分值从小到大排列; 分值用%f保存会丢失精度(1e-7读回为0) */
+static const std::vector<std::pair<std::string, std::string>> kScores = {
+        {kNulKey, "-2"},
+        {"tiny", "1e-07"},
+        {"fraction", "0.1234567"},
+        {"third", "0.3333333333333333"},
+        {kCrlfValue, "3"},
+        {"huge", "1.2345678901234567e+300"},
+};
+
+/* 1MB的大value，包含所有字节，内容固定 */
+static std::string bigValue() {
+    std::string value(1024 * 1024, '\0');
+    for (size_t i = 0; i < value.size(); ++i) {
+        value[i] = static_cast<char>((i * 131 + i / 251) & 0xff);
+    }
+    return value;
+}
+
+static std::vector<std::vector<std::string>> commands() {
+    std::vector<std::vector<std::string>> commands = {
+            {"SET", kNulKey, kNulValue},
+            {"SET", kCrlfKey, kCrlfValue},
+            {"SET", "empty", ""},
+            {"SET", "", "empty key"},
+            {"SET", "big", bigValue()},
+            {"SET", "expiring", "v"},
+            {"PEXPIRE", "expiring", "600000"},
+            {"RPUSH", "list", kNulValue, "", kCrlfValue, "tail"},
+            {"HSET", "hash", kCrlfKey, kNulValue},
+            {"HSET", "hash", "", ""},
+            {"SADD", "set", kNulValue},
+            {"SADD", "set", kCrlfValue},
+            {"SADD", "set", ""},
+    };
+    for (const auto& member : kScores) {
+        commands.push_back({"ZADD", "zset", member.first, member.second});
+    }
+    return commands;
+}
+
+/* 发送request和一个PING，收到PONG时之前的命令都已经执行，reply是PONG之前的回复 */
+static bool roundTrip(int fd, std::string request, std::string* reply) {
+    request += encode({"PING"});
+    for (size_t sent = 0; sent < request.size();) {
+        ssize_t n = ::write(fd, request.data() + sent, request.size() - sent);
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    char buf[4096];
+    const std::string pong = "+PONG\r\n";
+    while (reply->size() < pong.size() || reply->compare(reply->size() - pong.size(), pong.size(), pong) != 0) {
+        ssize_t n = ::read(fd, buf, sizeof buf);
+        if (n <= 0) {
+            return false;
+        }
+        reply->append(buf, static_cast<size_t>(n));
+    }
+    reply->resize(reply->size() - pong.size());
+    return true;
+}
+
+/* 写入所有数据，zsetReply是之后ZGETALL的回复 */
+static bool populate(uint16_t port, std::string* zsetReply) {
+    int fd = -1;
+    for (int i = 0; i < 100 && fd < 0; ++i) {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = InetAddress(port).getSockAddr();
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) {
+            ::close(fd);
+            fd = -1;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    if (fd < 0) {
+        perror("connect");
+        return false;
+    }
+    std::string request;
+    for (const auto& argv : commands()) {
+        request += encode(argv);
+    }
+    std::string reply;
+    bool ok = roundTrip(fd, request, &reply) && roundTrip(fd, encode({"ZGETALL", "zset"}), zsetReply);
+    ::close(fd);
+    /* 写命令的回复都是状态和整数，没有以'-'开头的错误 */
+    if (ok && reply.find('-') != std::string::npos) {
+        printf("error reply: %s\n", reply.c_str());
+        return false;
+    }
+    return ok;
+}
+
+/* 等待后台保存的子进程把dump.rdb rename到位(载入时创建的空文件不算) */
+static bool waitForDump() {
+    for (int i = 0; i < 500; ++i) {
+        struct stat st;
+        if (::stat("dump.rdb", &st) == 0 && st.st_size > 0) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static void checkRoundTrip(Database& db) {
+    auto str = [&db](const std::string& key) {
+        StringValue value = db.getStringValue(key);
+        return value == nullptr ? std::string("<nil>") : *value;
+    };
+    check(str(kNulKey) == kNulValue, "string with NUL");
+    check(str(kCrlfKey) == kCrlfValue, "string with CRLF and rdb tags");
+    check(str("empty").empty() && db.getStringValue("empty") != nullptr, "empty string value");
+    check(str("") == "empty key", "empty string key");
+    check(str("big") == bigValue(), "1MB binary value");
+    check(str("expiring") == "v" && db.getKeyExpiredTime(dbString, "expiring").valid(), "expire time kept");
+    check(!db.getKeyExpiredTime(dbString, "big").valid(), "no expire time added");
+
+    const auto& lists = db.getKeyListObj();
+    auto list = lists.find("list");
+    std::vector<std::string> expectList = {kNulValue, "", kCrlfValue, "tail"};
+    check(list != lists.end() && std::vector<std::string>(list->second.begin(), list->second.end()) == expectList,
+          "list elements and order");
+
+    const auto& hashes = db.getKeyHashObj();
+    auto hash = hashes.find("hash");
+    check(hash != hashes.end() && hash->second.size() == 2 && hash->second.at(kCrlfKey) == kNulValue &&
+          hash->second.at("").empty(), "hash fields");
+
+    const auto& sets = db.getKeySetObj();
+    auto set = sets.find("set");
+    check(set != sets.end() && set->second.size() == 3 && set->second.count(kNulValue) == 1 &&
+          set->second.count(kCrlfValue) == 1 && set->second.count("") == 1, "set members");
+
+    auto& zsets = db.getKeyZSetObj();
+    auto zset = zsets.find("zset");
+    bool zsetOk = zset != zsets.end();
+    if (zsetOk) {
+        RangeSpec spec(-DBL_MAX, DBL_MAX);
+        std::vector<SkipListNode*> nodes(zset->second->getNodeInRange(spec));
+        zsetOk = nodes.size() == kScores.size();
+        for (size_t i = 0; zsetOk && i < nodes.size(); ++i) {
+            zsetOk = nodes[i]->obj_ == kScores[i].first &&
+                     nodes[i]->score_ == strtod(kScores[i].second.c_str(), nullptr);
+        }
+    }
+    check(zsetOk, "zset members and scores");
+    check(db.getKeySize() == 10, "key count");
+}
+
+/* 旧版本(KV0001)保存的文件: 字符串中没有分隔符，长度和内容之间用!#$分隔 */
+static void checkLegacyFixture() {
+    {
+        std::ofstream out("dump.rdb", std::ios::out | std::ios::trunc | std::ios::binary);
+        out << "KV0001SD0^0ST0!5#hello!5$worldST0!1#k!0$"
+               "^2ST0!1#h!1!1#f!2$v1EOF";
+    }
+    Database db;
+    db.rdbLoad(0);
+    StringValue hello = db.getStringValue("hello");
+    check(hello != nullptr && *hello == "world", "KV0001 string");
+    StringValue empty = db.getStringValue("k");
+    check(empty != nullptr && empty->empty(), "KV0001 empty string");
+    const auto& hashes = db.getKeyHashObj();
+    auto hash = hashes.find("h");
+    check(hash != hashes.end() && hash->second.size() == 1 && hash->second.begin()->first == "f" &&
+          hash->second.begin()->second == "v1", "KV0001 hash");
+
+    Database other;
+    other.rdbLoad(1);
+    check(other.getKeySize() == 0, "KV0001 other db not loaded");
+}
+
+int main(int argc, char** argv) {
+    uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 19983);
+
+    char dir[] = "/tmp/kvdb_test_rdb.XXXXXX";
+    if (::mkdtemp(dir) == nullptr || ::chdir(dir) != 0) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    bool saved = false;
+    {
+        EventLoop loop;
+        DBServer server(&loop, InetAddress(port));
+        server.configure(Config());
+        server.start();
+        std::thread client([&loop, &server, &saved, port] {
+            std::string zsetReply;
+            bool ok = populate(port, &zsetReply);
+            check(ok, "populate over RESP");
+            /* 回复中的分值是可以原样读回的最短形式 */
+            for (const auto& member : kScores) {
+                const std::string& score = member.second;
+                if (zsetReply.find("$" + std::to_string(score.size()) + "\r\n" + score + "\r\n") == std::string::npos) {
+                    check(false, "ZGETALL score format");
+                    break;
+                }
+            }
+            if (ok) {
+                loop.runInLoop([&server] { server.rdbSave(); });
+                saved = waitForDump();
+                check(saved, "background save finished");
+            }
+            loop.quit();
+        });
+        loop.loop();
+        client.join();
+    }
+
+    if (saved) {
+        Database db;
+        db.rdbLoad(0);
+        checkRoundTrip(db);
+    }
+    checkLegacyFixture();
+
+    ::unlink("dump.rdb");
+    ::chdir("/");
+    ::rmdir(dir);
+    printf("%s\n", failures == 0 ? "ok" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}